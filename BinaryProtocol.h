@@ -0,0 +1,430 @@
+#pragma once
+
+#include "OrderBook.h"
+
+#include <span>
+
+// Binary order entry protocol in the style of SBE. Every message is an 8-byte
+// header followed by a fixed-layout block, with all integers little-endian at
+// fixed offsets:
+//
+//   Header       blockLength u16 @0, templateId u16 @2, schemaId u16 @4, version u16 @6
+//   NewOrder     orderId u64 @0, price i32 @8, quantity u32 @12, ownerId u32 @16,
+//                side u8 @20, orderType u8 @21, expiry u64 @24            (32 bytes)
+//   CancelOrder  orderId u64 @0                                           (8 bytes)
+//   ModifyOrder  orderId u64 @0, price i32 @8, quantity u32 @12, side u8 @16 (24 bytes)
+//   MassCancel   scope u8 @0, side u8 @1, ownerId u32 @4, minPrice i32 @8,
+//                maxPrice i32 @12                                          (16 bytes)
+//
+// and two reports flow back to the client:
+//
+//   StatusReport orderId u64 @0, templateId u16 @8, orderStatus u8 @10,
+//                decodeStatus u8 @11, cancelled u32 @12                    (16 bytes)
+//   FillReport   orderId u64 @0, price i32 @8, quantity u32 @12            (16 bytes)
+//
+// Side is 0 for buy and 1 for sell; order types number as in OrderType. A block
+// may be longer than listed, so fields can be appended without breaking readers.
+
+enum class MessageType : std::uint16_t {
+    NewOrder = 1,
+    CancelOrder = 2,
+    ModifyOrder = 3,
+    MassCancel = 4,
+    StatusReport = 101,
+    FillReport = 102
+};
+
+enum class MassCancelScope : std::uint8_t {
+    All,
+    Side,           // Every order on one side
+    PriceRange,     // Orders on one side priced within [minPrice, maxPrice]
+    Owner           // Every order of one owner
+};
+
+enum class DecodeStatus : std::uint8_t {
+    Decoded,        // Applied to the book; orderStatus holds the outcome
+    Incomplete,     // The buffer ends inside the message; nothing consumed
+    UnknownMessage, // Another schema or an unknown template; skipped
+    Malformed,      // Block too short or a field out of range; skipped
+    Refused         // Not allowed for the session's owner; skipped
+};
+
+constexpr std::uint16_t ProtocolSchemaId = 1;
+constexpr std::uint16_t ProtocolVersion = 1;
+
+// Fixed-offset field access, independent of host byte order and alignment
+struct LittleEndian {
+    template <typename T>
+    static T Load(const std::byte* data) {
+        using Unsigned = std::make_unsigned_t<T>;
+        Unsigned value = 0;
+        for (std::size_t i = 0; i < sizeof(T); ++i)
+            value |= static_cast<Unsigned>(std::to_integer<Unsigned>(data[i]) << (8 * i));
+        return static_cast<T>(value);
+    }
+
+    template <typename T>
+    static void Store(std::byte* data, T value) {
+        auto bits = static_cast<std::make_unsigned_t<T>>(value);
+        for (std::size_t i = 0; i < sizeof(T); ++i)
+            data[i] = static_cast<std::byte>(bits >> (8 * i));
+    }
+};
+
+// Views over a message in a receive buffer; nothing is copied until a field is read
+class MessageHeaderView {
+public:
+    static constexpr std::size_t Length = 8;
+
+    explicit MessageHeaderView(const std::byte* data) : data_{data} {}
+
+    std::uint16_t GetBlockLength() const { return LittleEndian::Load<std::uint16_t>(data_); }
+    std::uint16_t GetTemplateId() const { return LittleEndian::Load<std::uint16_t>(data_ + 2); }
+    std::uint16_t GetSchemaId() const { return LittleEndian::Load<std::uint16_t>(data_ + 4); }
+    std::uint16_t GetVersion() const { return LittleEndian::Load<std::uint16_t>(data_ + 6); }
+
+private:
+    const std::byte* data_;
+};
+
+class NewOrderView {
+public:
+    static constexpr std::size_t BlockLength = 32;
+
+    explicit NewOrderView(const std::byte* block) : block_{block} {}
+
+    std::uint64_t GetOrderId() const { return LittleEndian::Load<std::uint64_t>(block_); }
+    std::int32_t GetPrice() const { return LittleEndian::Load<std::int32_t>(block_ + 8); }
+    std::uint32_t GetQuantity() const { return LittleEndian::Load<std::uint32_t>(block_ + 12); }
+    std::uint32_t GetOwnerId() const { return LittleEndian::Load<std::uint32_t>(block_ + 16); }
+    std::uint8_t GetSide() const { return LittleEndian::Load<std::uint8_t>(block_ + 20); }
+    std::uint8_t GetOrderType() const { return LittleEndian::Load<std::uint8_t>(block_ + 21); }
+    Timestamp GetExpiry() const { return LittleEndian::Load<std::uint64_t>(block_ + 24); }
+
+private:
+    const std::byte* block_;
+};
+
+class CancelOrderView {
+public:
+    static constexpr std::size_t BlockLength = 8;
+
+    explicit CancelOrderView(const std::byte* block) : block_{block} {}
+
+    std::uint64_t GetOrderId() const { return LittleEndian::Load<std::uint64_t>(block_); }
+
+private:
+    const std::byte* block_;
+};
+
+class ModifyOrderView {
+public:
+    static constexpr std::size_t BlockLength = 24;
+
+    explicit ModifyOrderView(const std::byte* block) : block_{block} {}
+
+    std::uint64_t GetOrderId() const { return LittleEndian::Load<std::uint64_t>(block_); }
+    std::int32_t GetPrice() const { return LittleEndian::Load<std::int32_t>(block_ + 8); }
+    std::uint32_t GetQuantity() const { return LittleEndian::Load<std::uint32_t>(block_ + 12); }
+    std::uint8_t GetSide() const { return LittleEndian::Load<std::uint8_t>(block_ + 16); }
+
+private:
+    const std::byte* block_;
+};
+
+class MassCancelView {
+public:
+    static constexpr std::size_t BlockLength = 16;
+
+    explicit MassCancelView(const std::byte* block) : block_{block} {}
+
+    std::uint8_t GetScope() const { return LittleEndian::Load<std::uint8_t>(block_); }
+    std::uint8_t GetSide() const { return LittleEndian::Load<std::uint8_t>(block_ + 1); }
+    std::uint32_t GetOwnerId() const { return LittleEndian::Load<std::uint32_t>(block_ + 4); }
+    std::int32_t GetMinPrice() const { return LittleEndian::Load<std::int32_t>(block_ + 8); }
+    std::int32_t GetMaxPrice() const { return LittleEndian::Load<std::int32_t>(block_ + 12); }
+
+private:
+    const std::byte* block_;
+};
+
+// Outcome of one request; the order id is 0 for mass cancels
+class StatusReportView {
+public:
+    static constexpr std::size_t BlockLength = 16;
+
+    explicit StatusReportView(const std::byte* block) : block_{block} {}
+
+    std::uint64_t GetOrderId() const { return LittleEndian::Load<std::uint64_t>(block_); }
+    std::uint16_t GetTemplateId() const { return LittleEndian::Load<std::uint16_t>(block_ + 8); }
+    std::uint8_t GetOrderStatus() const { return LittleEndian::Load<std::uint8_t>(block_ + 10); }
+    std::uint8_t GetDecodeStatus() const { return LittleEndian::Load<std::uint8_t>(block_ + 11); }
+    std::uint32_t GetCancelled() const { return LittleEndian::Load<std::uint32_t>(block_ + 12); }
+
+private:
+    const std::byte* block_;
+};
+
+// One side of a trade, sent to the order's owner
+class FillReportView {
+public:
+    static constexpr std::size_t BlockLength = 16;
+
+    explicit FillReportView(const std::byte* block) : block_{block} {}
+
+    std::uint64_t GetOrderId() const { return LittleEndian::Load<std::uint64_t>(block_); }
+    std::int32_t GetPrice() const { return LittleEndian::Load<std::int32_t>(block_ + 8); }
+    std::uint32_t GetQuantity() const { return LittleEndian::Load<std::uint32_t>(block_ + 12); }
+
+private:
+    const std::byte* block_;
+};
+
+// Writes messages into a caller's buffer. Each call returns the message length,
+// or 0 if out is too small.
+class MessageEncoder {
+public:
+    static std::size_t EncodeNewOrder(std::span<std::byte> out, OrderType type, std::uint64_t orderId, Side side,
+                                      std::int32_t price, std::uint32_t quantity,
+                                      std::uint32_t ownerId = AnonymousOwner, Timestamp expiry = NoExpiry) {
+        std::byte* block = EncodeHeader(out, MessageType::NewOrder, NewOrderView::BlockLength);
+        if (block == nullptr)
+            return 0;
+        LittleEndian::Store(block, orderId);
+        LittleEndian::Store(block + 8, price);
+        LittleEndian::Store(block + 12, quantity);
+        LittleEndian::Store(block + 16, ownerId);
+        LittleEndian::Store(block + 20, EncodeSide(side));
+        LittleEndian::Store(block + 21, static_cast<std::uint8_t>(type));
+        LittleEndian::Store(block + 22, std::uint16_t{ 0 });
+        LittleEndian::Store(block + 24, expiry);
+        return MessageHeaderView::Length + NewOrderView::BlockLength;
+    }
+
+    static std::size_t EncodeCancelOrder(std::span<std::byte> out, std::uint64_t orderId) {
+        std::byte* block = EncodeHeader(out, MessageType::CancelOrder, CancelOrderView::BlockLength);
+        if (block == nullptr)
+            return 0;
+        LittleEndian::Store(block, orderId);
+        return MessageHeaderView::Length + CancelOrderView::BlockLength;
+    }
+
+    static std::size_t EncodeModifyOrder(std::span<std::byte> out, std::uint64_t orderId, Side side,
+                                         std::int32_t price, std::uint32_t quantity) {
+        std::byte* block = EncodeHeader(out, MessageType::ModifyOrder, ModifyOrderView::BlockLength);
+        if (block == nullptr)
+            return 0;
+        std::fill(block, block + ModifyOrderView::BlockLength, std::byte{ 0 });
+        LittleEndian::Store(block, orderId);
+        LittleEndian::Store(block + 8, price);
+        LittleEndian::Store(block + 12, quantity);
+        LittleEndian::Store(block + 16, EncodeSide(side));
+        return MessageHeaderView::Length + ModifyOrderView::BlockLength;
+    }
+
+    static std::size_t EncodeMassCancel(std::span<std::byte> out, MassCancelScope scope, Side side = Side::Buy,
+                                        std::int32_t minPrice = 0, std::int32_t maxPrice = 0,
+                                        std::uint32_t ownerId = AnonymousOwner) {
+        std::byte* block = EncodeHeader(out, MessageType::MassCancel, MassCancelView::BlockLength);
+        if (block == nullptr)
+            return 0;
+        LittleEndian::Store(block, static_cast<std::uint8_t>(scope));
+        LittleEndian::Store(block + 1, EncodeSide(side));
+        LittleEndian::Store(block + 2, std::uint16_t{ 0 });
+        LittleEndian::Store(block + 4, ownerId);
+        LittleEndian::Store(block + 8, minPrice);
+        LittleEndian::Store(block + 12, maxPrice);
+        return MessageHeaderView::Length + MassCancelView::BlockLength;
+    }
+
+    static std::size_t EncodeStatusReport(std::span<std::byte> out, std::uint64_t orderId, MessageType request,
+                                          OrderStatus orderStatus, DecodeStatus decodeStatus,
+                                          std::uint32_t cancelled = 0) {
+        std::byte* block = EncodeHeader(out, MessageType::StatusReport, StatusReportView::BlockLength);
+        if (block == nullptr)
+            return 0;
+        LittleEndian::Store(block, orderId);
+        LittleEndian::Store(block + 8, static_cast<std::uint16_t>(request));
+        LittleEndian::Store(block + 10, static_cast<std::uint8_t>(orderStatus));
+        LittleEndian::Store(block + 11, static_cast<std::uint8_t>(decodeStatus));
+        LittleEndian::Store(block + 12, cancelled);
+        return MessageHeaderView::Length + StatusReportView::BlockLength;
+    }
+
+    static std::size_t EncodeFillReport(std::span<std::byte> out, const TradeInfo& fill) {
+        std::byte* block = EncodeHeader(out, MessageType::FillReport, FillReportView::BlockLength);
+        if (block == nullptr)
+            return 0;
+        LittleEndian::Store(block, fill.order_id);
+        LittleEndian::Store(block + 8, fill.price_);
+        LittleEndian::Store(block + 12, fill.quantity_);
+        return MessageHeaderView::Length + FillReportView::BlockLength;
+    }
+
+private:
+    static std::uint8_t EncodeSide(Side side) { return side == Side::Buy ? 0 : 1; }
+
+    static std::byte* EncodeHeader(std::span<std::byte> out, MessageType type, std::size_t blockLength) {
+        if (out.size() < MessageHeaderView::Length + blockLength)
+            return nullptr;
+        LittleEndian::Store(out.data(), static_cast<std::uint16_t>(blockLength));
+        LittleEndian::Store(out.data() + 2, static_cast<std::uint16_t>(type));
+        LittleEndian::Store(out.data() + 4, ProtocolSchemaId);
+        LittleEndian::Store(out.data() + 6, ProtocolVersion);
+        return out.data() + MessageHeaderView::Length;
+    }
+};
+
+struct DecodeResult {
+    DecodeStatus status;
+    std::size_t length;         // Bytes consumed
+    MessageType type;
+    std::uint64_t orderId;      // 0 unless the message names an order
+    OrderStatus orderStatus;
+};
+
+// Decodes messages in place and applies them straight to a book, without building
+// Order or OrderModify objects. Trades and cancelled ids of the last message stay
+// available until the next one.
+//
+// A session bound to an owner, as for one client connection, enters every new
+// order under that owner and refuses mass cancels beyond its own orders. Its order
+// ids are its own: in the book each is prefixed with the owner id in the upper 32
+// bits, so two sessions may both use id 1 and neither can reach the other's
+// orders. Such a session's ids must fit in 32 bits; larger ones are malformed.
+// An anonymous session uses book ids as they are.
+template <typename Book>
+class ProtocolSession {
+public:
+    explicit ProtocolSession(Book& book, std::uint32_t ownerId = AnonymousOwner) : book_{book}, ownerId_{ownerId} {}
+
+    // Decode and apply the message at the start of buffer
+    DecodeResult Dispatch(std::span<const std::byte> buffer) {
+        trades_.clear();
+        cancelled_.clear();
+        if (buffer.size() < MessageHeaderView::Length)
+            return DecodeResult{ DecodeStatus::Incomplete, 0, MessageType{}, 0, OrderStatus::Accepted };
+        MessageHeaderView header{ buffer.data() };
+        DecodeResult result{ DecodeStatus::Malformed, MessageHeaderView::Length + header.GetBlockLength(),
+                             static_cast<MessageType>(header.GetTemplateId()), 0, OrderStatus::Accepted };
+        if (buffer.size() < result.length)
+            return DecodeResult{ DecodeStatus::Incomplete, 0, result.type, 0, OrderStatus::Accepted };
+        if (header.GetSchemaId() != ProtocolSchemaId) {
+            result.status = DecodeStatus::UnknownMessage;
+            return result;
+        }
+
+        const std::byte* block = buffer.data() + MessageHeaderView::Length;
+        switch (result.type) {
+            case MessageType::NewOrder:
+                if (header.GetBlockLength() >= NewOrderView::BlockLength)
+                    Apply(NewOrderView{ block }, result);
+                break;
+            case MessageType::CancelOrder:
+                if (header.GetBlockLength() >= CancelOrderView::BlockLength)
+                    Apply(CancelOrderView{ block }, result);
+                break;
+            case MessageType::ModifyOrder:
+                if (header.GetBlockLength() >= ModifyOrderView::BlockLength)
+                    Apply(ModifyOrderView{ block }, result);
+                break;
+            case MessageType::MassCancel:
+                if (header.GetBlockLength() >= MassCancelView::BlockLength)
+                    Apply(MassCancelView{ block }, result);
+                break;
+            default:
+                result.status = DecodeStatus::UnknownMessage;
+                break;
+        }
+        return result;
+    }
+
+    // Trades and cancelled orders name book ids; ToClientId recovers the session's
+    const std::vector<Trade>& GetTrades() const { return trades_; }
+    const std::vector<std::uint64_t>& GetCancelled() const { return cancelled_; }
+
+    std::uint64_t ToClientId(std::uint64_t bookId) const {
+        return ownerId_ == AnonymousOwner ? bookId : bookId & std::numeric_limits<std::uint32_t>::max();
+    }
+
+private:
+    static std::optional<Side> DecodeSide(std::uint8_t side) {
+        if (side > 1)
+            return std::nullopt;
+        return side == 0 ? Side::Buy : Side::Sell;
+    }
+
+    // The id a client's order has in the book, or nullopt if it is out of range
+    std::optional<std::uint64_t> ToBookId(std::uint64_t clientId) const {
+        if (ownerId_ == AnonymousOwner)
+            return clientId;
+        if (clientId > std::numeric_limits<std::uint32_t>::max())
+            return std::nullopt;
+        return std::uint64_t{ ownerId_ } << 32 | clientId;
+    }
+
+    void Apply(NewOrderView message, DecodeResult& result) {
+        result.orderId = message.GetOrderId();
+        auto side = DecodeSide(message.GetSide());
+        auto bookId = ToBookId(result.orderId);
+        if (!side || !bookId || message.GetOrderType() > static_cast<std::uint8_t>(OrderType::GoodForDay))
+            return;
+        std::uint32_t ownerId = ownerId_ == AnonymousOwner ? message.GetOwnerId() : ownerId_;
+        result.status = DecodeStatus::Decoded;
+        result.orderStatus = book_.AddOrder(static_cast<OrderType>(message.GetOrderType()), *bookId, *side,
+                                            message.GetPrice(), message.GetQuantity(), ownerId, message.GetExpiry(),
+                                            trades_);
+    }
+
+    void Apply(CancelOrderView message, DecodeResult& result) {
+        result.orderId = message.GetOrderId();
+        auto bookId = ToBookId(result.orderId);
+        if (!bookId)
+            return;
+        result.status = DecodeStatus::Decoded;
+        result.orderStatus = book_.CancelOrder(*bookId);
+    }
+
+    void Apply(ModifyOrderView message, DecodeResult& result) {
+        result.orderId = message.GetOrderId();
+        auto side = DecodeSide(message.GetSide());
+        auto bookId = ToBookId(result.orderId);
+        if (!side || !bookId)
+            return;
+        result.status = DecodeStatus::Decoded;
+        result.orderStatus = book_.MatchOrder(*bookId, *side, message.GetPrice(), message.GetQuantity(), trades_);
+    }
+
+    void Apply(MassCancelView message, DecodeResult& result) {
+        auto scope = static_cast<MassCancelScope>(message.GetScope());
+        auto side = DecodeSide(message.GetSide());
+        if (scope > MassCancelScope::Owner || (!side && (scope == MassCancelScope::Side ||
+                                                         scope == MassCancelScope::PriceRange)))
+            return;
+        if (ownerId_ != AnonymousOwner && scope != MassCancelScope::Owner) {
+            result.status = DecodeStatus::Refused;
+            return;
+        }
+
+        result.status = DecodeStatus::Decoded;
+        switch (scope) {
+            case MassCancelScope::All:
+                cancelled_ = book_.CancelAllOrders();
+                break;
+            case MassCancelScope::Side:
+                cancelled_ = book_.CancelOrders(*side);
+                break;
+            case MassCancelScope::PriceRange:
+                cancelled_ = book_.CancelOrders(*side, message.GetMinPrice(), message.GetMaxPrice());
+                break;
+            case MassCancelScope::Owner:
+                cancelled_ = book_.CancelOwnerOrders(ownerId_ == AnonymousOwner ? message.GetOwnerId() : ownerId_);
+                break;
+        }
+    }
+
+    Book& book_;
+    std::uint32_t ownerId_;
+    std::vector<Trade> trades_;
+    std::vector<std::uint64_t> cancelled_;
+};
@@ -0,0 +1,618 @@
+#pragma once
+
+#include "OrderEntryServer.h"
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Submission and completion rings of one io_uring instance, set up with the raw
+// syscalls so no liburing is needed
+class IoUring {
+public:
+    // Nullopt on failure, with errno set; ENOSYS or EPERM where io_uring is
+    // unavailable or disabled
+    static std::optional<IoUring> Create(unsigned entries) {
+        io_uring_params params{};
+        params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+        FileDescriptor ring{ static_cast<int>(syscall(__NR_io_uring_setup, entries, &params)) };
+        if (!ring.IsValid() && errno == EINVAL) {
+            // Kernels before 6.1 lack both flags
+            params = {};
+            ring.Reset(static_cast<int>(syscall(__NR_io_uring_setup, entries, &params)));
+        }
+        if (!ring.IsValid())
+            return std::nullopt;
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+            errno = ENOSYS;
+            return std::nullopt;
+        }
+
+        std::size_t ringsSize = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                         params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        void* rings = mmap(nullptr, ringsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.Get(),
+                           IORING_OFF_SQ_RING);
+        if (rings == MAP_FAILED)
+            return std::nullopt;
+        std::size_t sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.Get(),
+                          IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            int error = errno;
+            munmap(rings, ringsSize);
+            errno = error;
+            return std::nullopt;
+        }
+        return IoUring{ std::move(ring), params, rings, ringsSize, static_cast<io_uring_sqe*>(sqes), sqesSize };
+    }
+
+    IoUring(IoUring&& other) noexcept
+            : ring_{std::move(other.ring_)}, rings_{std::exchange(other.rings_, nullptr)},
+              ringsSize_{other.ringsSize_}, sqes_{std::exchange(other.sqes_, nullptr)}, sqesSize_{other.sqesSize_},
+              sqHead_{other.sqHead_}, sqTail_{other.sqTail_}, sqMask_{other.sqMask_}, sqEntries_{other.sqEntries_},
+              cqHead_{other.cqHead_}, cqTail_{other.cqTail_}, cqMask_{other.cqMask_}, cqes_{other.cqes_},
+              tail_{other.tail_} {}
+
+    IoUring& operator=(IoUring&&) = delete;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        // Closing the ring first cancels whatever is still in flight
+        ring_.Reset();
+        if (sqes_ != nullptr)
+            munmap(sqes_, sqesSize_);
+        if (rings_ != nullptr)
+            munmap(rings_, ringsSize_);
+    }
+
+    // Register one buffer as fixed buffer 0 for READ_FIXED and WRITE_FIXED
+    bool RegisterBuffer(void* data, std::size_t size) {
+        iovec buffer{ data, size };
+        return syscall(__NR_io_uring_register, ring_.Get(), IORING_REGISTER_BUFFERS, &buffer, 1) == 0;
+    }
+
+    // Next submission entry, cleared; nullptr when the queue is full
+    io_uring_sqe* GetSqe() {
+        if (tail_ - std::atomic_ref{ *sqHead_ }.load(std::memory_order_acquire) >= sqEntries_)
+            return nullptr;
+        io_uring_sqe* sqe = &sqes_[tail_++ & sqMask_];
+        *sqe = io_uring_sqe{};
+        return sqe;
+    }
+
+    // Submit everything queued without waiting, as when the queue is full. False
+    // on failure, with errno set; an interrupted call is not a failure.
+    bool Submit() {
+        std::atomic_ref{ *sqTail_ }.store(tail_, std::memory_order_release);
+        unsigned queued = tail_ - std::atomic_ref{ *sqHead_ }.load(std::memory_order_acquire);
+        return syscall(__NR_io_uring_enter, ring_.Get(), queued, 0, 0, nullptr, 0) >= 0 || errno == EINTR ||
+               errno == EAGAIN;
+    }
+
+    // Submit everything queued, then wait up to timeout for a completion unless
+    // one is ready. False on failure, with errno set; an interrupted or timed out
+    // wait is not a failure.
+    bool Enter(long timeoutNanoseconds) {
+        std::atomic_ref{ *sqTail_ }.store(tail_, std::memory_order_release);
+        unsigned queued = tail_ - std::atomic_ref{ *sqHead_ }.load(std::memory_order_acquire);
+        __kernel_timespec timeout{ timeoutNanoseconds / 1'000'000'000, timeoutNanoseconds % 1'000'000'000 };
+        io_uring_getevents_arg arg{};
+        arg.ts = reinterpret_cast<std::uint64_t>(&timeout);
+        long result = syscall(__NR_io_uring_enter, ring_.Get(), queued, 1,
+                              IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+        return result >= 0 || errno == EINTR || errno == ETIME || errno == EBUSY;
+    }
+
+    // Consume every completion that is ready
+    template <typename Visitor>
+    void ForEachCompletion(Visitor&& visit) {
+        unsigned head = *cqHead_;
+        unsigned tail = std::atomic_ref{ *cqTail_ }.load(std::memory_order_acquire);
+        for (; head != tail; ++head) {
+            io_uring_cqe cqe = cqes_[head & cqMask_];
+            std::atomic_ref{ *cqHead_ }.store(head + 1, std::memory_order_release);
+            visit(cqe);
+        }
+    }
+
+private:
+    IoUring(FileDescriptor ring, const io_uring_params& params, void* rings, std::size_t ringsSize,
+            io_uring_sqe* sqes, std::size_t sqesSize)
+            : ring_{std::move(ring)}, rings_{rings}, ringsSize_{ringsSize}, sqes_{sqes}, sqesSize_{sqesSize} {
+        auto* bytes = static_cast<std::byte*>(rings);
+        sqHead_ = reinterpret_cast<unsigned*>(bytes + params.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(bytes + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(bytes + params.sq_off.ring_mask);
+        sqEntries_ = params.sq_entries;
+        cqHead_ = reinterpret_cast<unsigned*>(bytes + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(bytes + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(bytes + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(bytes + params.cq_off.cqes);
+        tail_ = *sqTail_;
+        // Submission slots map one to one onto entries
+        auto* array = reinterpret_cast<unsigned*>(bytes + params.sq_off.array);
+        for (unsigned i = 0; i < sqEntries_; ++i)
+            array[i] = i;
+    }
+
+    FileDescriptor ring_;
+    void* rings_;
+    std::size_t ringsSize_;
+    io_uring_sqe* sqes_;
+    std::size_t sqesSize_;
+    unsigned* sqHead_{nullptr};
+    unsigned* sqTail_{nullptr};
+    unsigned sqMask_{0};
+    unsigned sqEntries_{0};
+    unsigned* cqHead_{nullptr};
+    unsigned* cqTail_{nullptr};
+    unsigned cqMask_{0};
+    io_uring_cqe* cqes_{nullptr};
+    unsigned tail_{0};          // Local submission tail, published by Enter
+};
+
+// Completion-based I/O for OrderEntryServer on io_uring, with the same interface
+// as EpollBackend. Each connection keeps a receive armed into its slice of one
+// registered arena (READ_FIXED); journal appends are staged in two registered
+// buffers and written with WRITE_FIXED, one write in flight at a time; reports
+// are sent from a per-connection buffer, one send in flight at a time. Everything
+// queued in an iteration reaches the kernel with the wait for the next
+// completions, in a single io_uring_enter.
+//
+// As with EpollBackend, reports only go out once the journal write covering the
+// messages they answer has completed; until then they stay queued.
+//
+// The arena is sized for a fixed number of connections, set at creation; clients
+// connecting beyond it are closed straight after accept.
+class IoUringBackend {
+public:
+    static constexpr std::size_t JournalStaging = 1 << 19;
+    static constexpr std::uint32_t DefaultMaxConnections = 64;
+
+    // Nullopt if io_uring is unavailable or the arena cannot be registered, with
+    // errno set; fall back to EpollBackend then
+    static std::optional<IoUringBackend> Create(std::uint32_t maxConnections = DefaultMaxConnections) {
+        if (maxConnections == 0) {
+            errno = EINVAL;
+            return std::nullopt;
+        }
+        // Room for a receive and a send per connection, the accept and the
+        // journal write, so the queue rarely fills up between iterations
+        auto ring = IoUring::Create(std::bit_ceil(2 * maxConnections + 2));
+        if (!ring)
+            return std::nullopt;
+        std::size_t arenaSize = maxConnections * SessionInputCapacity + 2 * JournalStaging;
+        auto arena = std::make_unique<std::byte[]>(arenaSize);
+        if (!ring->RegisterBuffer(arena.get(), arenaSize))
+            return std::nullopt;
+        return IoUringBackend{ std::move(*ring), std::move(arena), maxConnections };
+    }
+
+    IoUringBackend(IoUringBackend&&) = default;
+
+    bool Listen(const std::string& address, std::uint16_t port) {
+        listener_ = OpenListener(address, port, 0);
+        if (!listener_.IsValid())
+            return false;
+        ArmAccept();
+        return true;
+    }
+
+    std::uint16_t GetPort() const { return GetListenerPort(listener_); }
+
+    bool OpenJournal(const std::string& path) {
+        journal_ = OpenJournalFile(path);
+        return journal_.IsValid();
+    }
+
+    std::uint64_t GetSyscallCount() const { return syscalls_; }
+    std::uint32_t GetMaxConnections() const { return static_cast<std::uint32_t>(connections_.size()); }
+    // Clients closed because every connection slot was taken
+    std::uint64_t GetRefusedCount() const { return refused_; }
+
+    // Submit what the last iteration queued and wait up to timeout for
+    // completions, then deliver them. False on a ring or journal failure, with
+    // errno set.
+    template <typename Handler>
+    bool Poll(Handler& handler, int timeoutMilliseconds) {
+        ++syscalls_;
+        if (!ring_.Enter(timeoutMilliseconds * 1'000'000L))
+            return false;
+        ring_.ForEachCompletion([&](const io_uring_cqe& cqe) { Complete(cqe, handler); });
+        return Healthy();
+    }
+
+    // Queue bytes for the connection; false once it has too much unsent
+    bool Send(std::uint32_t id, std::span<const std::byte> bytes) {
+        Connection* connection = Find(id);
+        if (connection == nullptr ||
+            connection->pending.size() + connection->sending.size() + bytes.size() > MaxPendingOutput)
+            return false;
+        connection->pending.insert(connection->pending.end(), bytes.begin(), bytes.end());
+        MarkDirty(id, *connection);
+        if (journal_.IsValid() && !connection->reported) {
+            connection->reported = true;
+            reported_.push_back(id);
+        }
+        return true;
+    }
+
+    void Append(std::span<const std::byte> bytes) {
+        if (!journal_.IsValid())
+            return;
+        if (journalSize_ + bytes.size() > JournalStaging) {
+            // Staging is full while the other buffer is still in flight
+            WriteJournal(std::span{ JournalBuffer(journalActive_), journalSize_ });
+            journalSize_ = 0;
+        }
+        if (bytes.size() > JournalStaging) {
+            WriteJournal(bytes);
+            return;
+        }
+        std::copy(bytes.begin(), bytes.end(), JournalBuffer(journalActive_) + journalSize_);
+        journalSize_ += bytes.size();
+    }
+
+    // Queue the staged journal, and a send for each connection with reports whose
+    // journal records are written; they are submitted by the next Poll. False if
+    // the journal or the ring fails, with errno set.
+    template <typename Handler>
+    bool Flush(Handler&) {
+        if (!journalInFlight_) {
+            if (journalSize_ > 0)
+                SubmitJournal();
+            else
+                // Everything appended since the last write went out synchronously
+                ReleaseReports();
+        }
+        for (std::uint32_t id : dirty_) {
+            Connection& connection = connections_[id - 1];
+            connection.dirty = false;
+            if (!journal_.IsValid())
+                connection.covered = connection.journaled = connection.pending.size();
+            if (connection.open && !connection.sendInFlight && connection.journaled > 0) {
+                auto end = connection.pending.begin() + static_cast<std::ptrdiff_t>(connection.journaled);
+                connection.sending.assign(connection.pending.begin(), end);
+                connection.pending.erase(connection.pending.begin(), end);
+                connection.covered -= connection.journaled;
+                connection.journaled = 0;
+                connection.sent = 0;
+                ArmSend(id, connection);
+            }
+        }
+        dirty_.clear();
+        return Healthy();
+    }
+    // Close without a callback. The id is reused once the connection's receive
+    // and send have completed.
+    void Close(std::uint32_t id) {
+        Connection* connection = Find(id);
+        if (connection == nullptr)
+            return;
+        connection->open = false;
+        // Completes the armed receive
+        ++syscalls_;
+        shutdown(connection->fd.Get(), SHUT_RDWR);
+        Release(id, *connection);
+    }
+
+private:
+    enum class Operation : std::uint8_t { Accept, Receive, Send, Journal };
+
+    struct Connection {
+        FileDescriptor fd;
+        std::size_t inputSize{0};
+        std::vector<std::byte> pending;     // Queued since the last send was armed
+        std::size_t covered{0};             // Leading pending bytes the journal write in flight answers for
+        std::size_t journaled{0};           // Leading pending bytes that may be sent
+        std::vector<std::byte> sending;     // The kernel's until the send completes
+        std::size_t sent{0};
+        bool receiving{false};
+        bool sendInFlight{false};
+        bool dirty{false};
+        bool reported{false};               // Listed in reported_
+        bool awaitingJournal{false};        // Listed in journalWaiters_
+        bool open{false};
+    };
+
+    struct JournalWrite {
+        std::uint64_t offset;
+        unsigned buffer;
+        std::size_t size;
+    };
+
+    IoUringBackend(IoUring ring, std::unique_ptr<std::byte[]> arena, std::uint32_t maxConnections)
+            : arena_{std::move(arena)}, connections_(maxConnections), ring_{std::move(ring)} {
+        for (std::uint32_t id = maxConnections; id > 0; --id)
+            freeIds_.push_back(id);
+    }
+
+    static std::uint64_t Tag(std::uint32_t id, Operation operation) {
+        return static_cast<std::uint64_t>(id) << 8 | static_cast<std::uint8_t>(operation);
+    }
+
+    std::byte* Input(std::uint32_t id) { return arena_.get() + (id - 1) * SessionInputCapacity; }
+
+    std::byte* JournalBuffer(unsigned buffer) {
+        return arena_.get() + connections_.size() * SessionInputCapacity + buffer * JournalStaging;
+    }
+
+    Connection* Find(std::uint32_t id) {
+        if (id == 0 || id > connections_.size() || !connections_[id - 1].open)
+            return nullptr;
+        return &connections_[id - 1];
+    }
+
+    // A submission entry, submitting what is queued first if the queue is full;
+    // nullptr once the ring fails, which the next Poll or Flush reports
+    io_uring_sqe* NextSqe() {
+        io_uring_sqe* sqe = ring_.GetSqe();
+        while (sqe == nullptr && error_ == 0) {
+            ++syscalls_;
+            if (!ring_.Submit())
+                error_ = errno;
+            sqe = ring_.GetSqe();
+        }
+        return sqe;
+    }
+
+    // Hand the staged journal to the kernel; reports queued so far wait for it
+    void SubmitJournal() {
+        io_uring_sqe* sqe = NextSqe();
+        if (sqe == nullptr)
+            return;
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->fd = journal_.Get();
+        sqe->addr = reinterpret_cast<std::uint64_t>(JournalBuffer(journalActive_));
+        sqe->len = static_cast<std::uint32_t>(journalSize_);
+        sqe->off = journalOffset_;
+        sqe->buf_index = 0;
+        sqe->user_data = Tag(0, Operation::Journal);
+        journalWrite_ = { journalOffset_, journalActive_, journalSize_ };
+        journalOffset_ += journalSize_;
+        journalActive_ ^= 1;
+        journalSize_ = 0;
+        journalInFlight_ = true;
+
+        for (std::uint32_t id : reported_) {
+            Connection& connection = connections_[id - 1];
+            if (!connection.reported)
+                continue;
+            connection.reported = false;
+            connection.covered = connection.pending.size();
+            connection.awaitingJournal = true;
+            journalWaiters_.push_back(id);
+        }
+        reported_.clear();
+    }
+
+    // The journal write in flight completed, so the reports it covers may go out
+    void JournalWritten() {
+        journalInFlight_ = false;
+        for (std::uint32_t id : journalWaiters_) {
+            Connection& connection = connections_[id - 1];
+            if (!connection.awaitingJournal)
+                continue;
+            connection.awaitingJournal = false;
+            connection.journaled = connection.covered;
+            MarkDirty(id, connection);
+        }
+        journalWaiters_.clear();
+    }
+
+    // Nothing is staged or in flight, so every report queued answers for
+    // messages already written
+    void ReleaseReports() {
+        for (std::uint32_t id : reported_) {
+            Connection& connection = connections_[id - 1];
+            if (!connection.reported)
+                continue;
+            connection.reported = false;
+            connection.covered = connection.journaled = connection.pending.size();
+            MarkDirty(id, connection);
+        }
+        reported_.clear();
+    }
+
+    void ArmAccept() {
+        io_uring_sqe* sqe = NextSqe();
+        if (sqe == nullptr)
+            return;
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = listener_.Get();
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->user_data = Tag(0, Operation::Accept);
+    }
+
+    void ArmReceive(std::uint32_t id, Connection& connection) {
+        io_uring_sqe* sqe = NextSqe();
+        if (sqe == nullptr)
+            return;
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->fd = connection.fd.Get();
+        sqe->addr = reinterpret_cast<std::uint64_t>(Input(id) + connection.inputSize);
+        sqe->len = static_cast<std::uint32_t>(SessionInputCapacity - connection.inputSize);
+        sqe->off = static_cast<std::uint64_t>(-1);
+        sqe->buf_index = 0;
+        sqe->user_data = Tag(id, Operation::Receive);
+        connection.receiving = true;
+    }
+
+    void ArmSend(std::uint32_t id, Connection& connection) {
+        io_uring_sqe* sqe = NextSqe();
+        if (sqe == nullptr)
+            return;
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = connection.fd.Get();
+        sqe->addr = reinterpret_cast<std::uint64_t>(connection.sending.data() + connection.sent);
+        sqe->len = static_cast<std::uint32_t>(connection.sending.size() - connection.sent);
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = Tag(id, Operation::Send);
+        connection.sendInFlight = true;
+    }
+
+    template <typename Handler>
+    void Complete(const io_uring_cqe& cqe, Handler& handler) {
+        auto id = static_cast<std::uint32_t>(cqe.user_data >> 8);
+        switch (static_cast<Operation>(cqe.user_data & 0xff)) {
+            case Operation::Accept:
+                if (cqe.res >= 0)
+                    Adopt(cqe.res, handler);
+                ArmAccept();
+                break;
+            case Operation::Receive:
+                Received(id, cqe.res, handler);
+                break;
+            case Operation::Send:
+                Sent(id, cqe.res, handler);
+                break;
+            case Operation::Journal:
+                if (cqe.res < 0)
+                    error_ = -cqe.res;
+                else if (static_cast<std::size_t>(cqe.res) < journalWrite_.size)
+                    WriteJournal(std::span{ JournalBuffer(journalWrite_.buffer) + cqe.res,
+                                            journalWrite_.size - static_cast<std::size_t>(cqe.res) },
+                                 journalWrite_.offset + static_cast<std::uint64_t>(cqe.res));
+                // Reports wait for good: the server stops on a journal failure
+                if (error_ == 0)
+                    JournalWritten();
+                break;
+        }
+    }
+
+    template <typename Handler>
+    void Adopt(int fd, Handler& handler) {
+        if (freeIds_.empty()) {
+            close(fd);
+            ++refused_;
+            return;
+        }
+        std::uint32_t id = freeIds_.back();
+        freeIds_.pop_back();
+        int noDelay = 1;
+        ++syscalls_;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        Connection& connection = connections_[id - 1];
+        connection.fd.Reset(fd);
+        connection.inputSize = 0;
+        connection.covered = connection.journaled = 0;
+        connection.open = true;
+        ArmReceive(id, connection);
+        handler.OnConnect(id);
+    }
+
+    template <typename Handler>
+    void Received(std::uint32_t id, int result, Handler& handler) {
+        Connection& connection = connections_[id - 1];
+        connection.receiving = false;
+        if (connection.open && result <= 0) {
+            Close(id);
+            handler.OnDisconnect(id);
+            return;
+        }
+        if (!connection.open) {
+            Release(id, connection);
+            return;
+        }
+
+        connection.inputSize += static_cast<std::size_t>(result);
+        std::byte* input = Input(id);
+        std::size_t consumed = handler.OnReceive(id, std::span<const std::byte>{ input, connection.inputSize });
+        std::copy(input + consumed, input + connection.inputSize, input);
+        connection.inputSize -= consumed;
+        if (connection.open)
+            ArmReceive(id, connection);
+        else
+            Release(id, connection);
+    }
+
+    template <typename Handler>
+    void Sent(std::uint32_t id, int result, Handler& handler) {
+        Connection& connection = connections_[id - 1];
+        connection.sendInFlight = false;
+        if (connection.open && result < 0) {
+            Close(id);
+            handler.OnDisconnect(id);
+            return;
+        }
+        if (!connection.open) {
+            Release(id, connection);
+            return;
+        }
+
+        connection.sent += static_cast<std::size_t>(result);
+        if (connection.sent < connection.sending.size()) {
+            ArmSend(id, connection);
+            return;
+        }
+        connection.sending.clear();
+        if (!connection.pending.empty())
+            MarkDirty(id, connection);
+    }
+
+    // Free a closed connection's id once the kernel is done with its buffers
+    void Release(std::uint32_t id, Connection& connection) {
+        if (connection.receiving || connection.sendInFlight || !connection.fd.IsValid())
+            return;
+        connection.fd.Reset();
+        connection.pending.clear();
+        connection.sending.clear();
+        // Stale entries in reported_ and journalWaiters_ are skipped
+        connection.reported = connection.awaitingJournal = false;
+        freeIds_.push_back(id);
+    }
+
+    void MarkDirty(std::uint32_t id, Connection& connection) {
+        if (!connection.dirty) {
+            connection.dirty = true;
+            dirty_.push_back(id);
+        }
+    }
+
+    // Synchronous path for when staging overflows or a write comes back short
+    void WriteJournal(std::span<const std::byte> bytes, std::uint64_t offset) {
+        std::size_t written = 0;
+        while (written < bytes.size() && error_ == 0) {
+            ++syscalls_;
+            ssize_t result = pwrite(journal_.Get(), bytes.data() + written, bytes.size() - written,
+                                    static_cast<off_t>(offset + written));
+            if (result < 0 && errno != EINTR)
+                error_ = errno;
+            written += static_cast<std::size_t>(std::max<ssize_t>(result, 0));
+        }
+    }
+
+    void WriteJournal(std::span<const std::byte> bytes) {
+        WriteJournal(bytes, journalOffset_);
+        journalOffset_ += bytes.size();
+    }
+
+    bool Healthy() {
+        if (error_ == 0)
+            return true;
+        errno = error_;
+        return false;
+    }
+
+    std::unique_ptr<std::byte[]> arena_;
+    std::vector<Connection> connections_;
+    std::vector<std::uint32_t> freeIds_;
+    std::vector<std::uint32_t> dirty_;
+    std::vector<std::uint32_t> reported_;       // Queued reports since the last journal write was submitted
+    std::vector<std::uint32_t> journalWaiters_; // Reports covered by the journal write in flight
+    FileDescriptor listener_;
+    FileDescriptor journal_;
+    std::uint64_t journalOffset_{0};
+    std::size_t journalSize_{0};
+    unsigned journalActive_{0};
+    bool journalInFlight_{false};
+    JournalWrite journalWrite_{};
+    int error_{0};              // Ring or journal failure
+    std::uint64_t syscalls_{0};
+    std::uint64_t refused_{0};
+    // Last, so it is destroyed first and nothing in flight outlives the buffers
+    IoUring ring_;
+};
@@ -0,0 +1,904 @@
+#pragma once
+
+#include "OrderEntryServer.h"
+
+#include <chrono>
+
+#include <sys/socket.h>
+
+// Market data feed over UDP. The incremental channel carries every trade and
+// every change to the aggregated levels; the snapshot channel carries the whole
+// book whenever a receiver asks for it on the request port. Messages use the order
+// entry framing (8-byte header, fixed little-endian blocks) under their own schema
+// id, packed into datagrams behind a packet header:
+//
+//   Packet          sequence u64 @0, messageCount u16 @8, channel u16 @10,
+//                   reserved u32 @12                                       (16 bytes)
+//   LevelUpdate     price i32 @0, quantity u32 @4, side u8 @8              (12 bytes)
+//   TradePrint      price i32 @0, quantity u32 @4                          (8 bytes)
+//   SnapshotBegin   lastSequence u64 @0, bidCount u32 @8, askCount u32 @12 (16 bytes)
+//   SnapshotLevel   price i32 @0, quantity u32 @4, side u8 @8              (12 bytes)
+//   SnapshotRequest nextSequence u64 @0                                   (8 bytes)
+//
+// Each channel numbers its messages from 1 and a packet's sequence is that of its
+// first message, so a receiver expecting a different one has missed packets. A
+// level update sets the level's aggregate quantity, 0 removing the level. A
+// snapshot is a SnapshotBegin followed by its bid then ask levels, best first, and
+// is the book as of incremental message lastSequence.
+
+enum class MarketDataType : std::uint16_t {
+    LevelUpdate = 1,
+    TradePrint = 2,
+    SnapshotBegin = 3,
+    SnapshotLevel = 4,
+    SnapshotRequest = 5
+};
+
+enum class MarketDataChannel : std::uint16_t {
+    Incremental,
+    Snapshot
+};
+
+constexpr std::uint16_t MarketDataSchemaId = 2;
+constexpr std::uint16_t MarketDataVersion = 1;
+
+class PacketHeaderView {
+public:
+    static constexpr std::size_t Length = 16;
+
+    explicit PacketHeaderView(const std::byte* data) : data_{data} {}
+
+    std::uint64_t GetSequence() const { return LittleEndian::Load<std::uint64_t>(data_); }
+    std::uint16_t GetMessageCount() const { return LittleEndian::Load<std::uint16_t>(data_ + 8); }
+    std::uint16_t GetChannel() const { return LittleEndian::Load<std::uint16_t>(data_ + 10); }
+
+private:
+    const std::byte* data_;
+};
+
+// LevelUpdate and SnapshotLevel share this block
+class LevelUpdateView {
+public:
+    static constexpr std::size_t BlockLength = 12;
+
+    explicit LevelUpdateView(const std::byte* block) : block_{block} {}
+
+    std::int32_t GetPrice() const { return LittleEndian::Load<std::int32_t>(block_); }
+    std::uint32_t GetQuantity() const { return LittleEndian::Load<std::uint32_t>(block_ + 4); }
+    std::uint8_t GetSide() const { return LittleEndian::Load<std::uint8_t>(block_ + 8); }
+
+private:
+    const std::byte* block_;
+};
+
+class TradePrintView {
+public:
+    static constexpr std::size_t BlockLength = 8;
+
+    explicit TradePrintView(const std::byte* block) : block_{block} {}
+
+    std::int32_t GetPrice() const { return LittleEndian::Load<std::int32_t>(block_); }
+    std::uint32_t GetQuantity() const { return LittleEndian::Load<std::uint32_t>(block_ + 4); }
+
+private:
+    const std::byte* block_;
+};
+
+class SnapshotBeginView {
+public:
+    static constexpr std::size_t BlockLength = 16;
+
+    explicit SnapshotBeginView(const std::byte* block) : block_{block} {}
+
+    std::uint64_t GetLastSequence() const { return LittleEndian::Load<std::uint64_t>(block_); }
+    std::uint32_t GetBidCount() const { return LittleEndian::Load<std::uint32_t>(block_ + 8); }
+    std::uint32_t GetAskCount() const { return LittleEndian::Load<std::uint32_t>(block_ + 12); }
+
+private:
+    const std::byte* block_;
+};
+
+class SnapshotRequestView {
+public:
+    static constexpr std::size_t BlockLength = 8;
+
+    explicit SnapshotRequestView(const std::byte* block) : block_{block} {}
+
+    std::uint64_t GetNextSequence() const { return LittleEndian::Load<std::uint64_t>(block_); }
+
+private:
+    const std::byte* block_;
+};
+
+// Writes market data messages into a caller's buffer. Each call returns the
+// message length, or 0 if out is too small.
+class MarketDataEncoder {
+public:
+    static std::size_t EncodePacketHeader(std::span<std::byte> out, std::uint64_t sequence,
+                                          std::uint16_t messageCount, MarketDataChannel channel) {
+        if (out.size() < PacketHeaderView::Length)
+            return 0;
+        LittleEndian::Store(out.data(), sequence);
+        LittleEndian::Store(out.data() + 8, messageCount);
+        LittleEndian::Store(out.data() + 10, static_cast<std::uint16_t>(channel));
+        LittleEndian::Store(out.data() + 12, std::uint32_t{ 0 });
+        return PacketHeaderView::Length;
+    }
+
+    // A LevelUpdate, or a SnapshotLevel
+    static std::size_t EncodeLevel(std::span<std::byte> out, MarketDataType type, Side side, std::int32_t price,
+                                   std::uint32_t quantity) {
+        std::byte* block = EncodeHeader(out, type, LevelUpdateView::BlockLength);
+        if (block == nullptr)
+            return 0;
+        std::fill(block, block + LevelUpdateView::BlockLength, std::byte{ 0 });
+        LittleEndian::Store(block, price);
+        LittleEndian::Store(block + 4, quantity);
+        LittleEndian::Store(block + 8, static_cast<std::uint8_t>(side == Side::Buy ? 0 : 1));
+        return MessageHeaderView::Length + LevelUpdateView::BlockLength;
+    }
+
+    static std::size_t EncodeTradePrint(std::span<std::byte> out, std::int32_t price, std::uint32_t quantity) {
+        std::byte* block = EncodeHeader(out, MarketDataType::TradePrint, TradePrintView::BlockLength);
+        if (block == nullptr)
+            return 0;
+        LittleEndian::Store(block, price);
+        LittleEndian::Store(block + 4, quantity);
+        return MessageHeaderView::Length + TradePrintView::BlockLength;
+    }
+
+    static std::size_t EncodeSnapshotBegin(std::span<std::byte> out, std::uint64_t lastSequence,
+                                           std::uint32_t bidCount, std::uint32_t askCount) {
+        std::byte* block = EncodeHeader(out, MarketDataType::SnapshotBegin, SnapshotBeginView::BlockLength);
+        if (block == nullptr)
+            return 0;
+        LittleEndian::Store(block, lastSequence);
+        LittleEndian::Store(block + 8, bidCount);
+        LittleEndian::Store(block + 12, askCount);
+        return MessageHeaderView::Length + SnapshotBeginView::BlockLength;
+    }
+
+    static std::size_t EncodeSnapshotRequest(std::span<std::byte> out, std::uint64_t nextSequence) {
+        std::byte* block = EncodeHeader(out, MarketDataType::SnapshotRequest, SnapshotRequestView::BlockLength);
+        if (block == nullptr)
+            return 0;
+        LittleEndian::Store(block, nextSequence);
+        return MessageHeaderView::Length + SnapshotRequestView::BlockLength;
+    }
+
+private:
+    static std::byte* EncodeHeader(std::span<std::byte> out, MarketDataType type, std::size_t blockLength) {
+        if (out.size() < MessageHeaderView::Length + blockLength)
+            return nullptr;
+        LittleEndian::Store(out.data(), static_cast<std::uint16_t>(blockLength));
+        LittleEndian::Store(out.data() + 2, static_cast<std::uint16_t>(type));
+        LittleEndian::Store(out.data() + 4, MarketDataSchemaId);
+        LittleEndian::Store(out.data() + 6, MarketDataVersion);
+        return out.data() + MessageHeaderView::Length;
+    }
+};
+
+// False with errno set to EINVAL if address is not a dotted IPv4 address
+inline bool MakeSocketAddress(const std::string& address, std::uint16_t port, sockaddr_in& out) {
+    out = sockaddr_in{};
+    out.sin_family = AF_INET;
+    out.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &out.sin_addr) != 1) {
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+// Nonblocking UDP socket bound to address:port; port 0 picks a free one. Invalid
+// on failure, with errno set.
+inline FileDescriptor OpenDatagramSocket(const std::string& address, std::uint16_t port) {
+    sockaddr_in local;
+    if (!MakeSocketAddress(address, port, local))
+        return {};
+    FileDescriptor socket{ ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0) };
+    if (!socket.IsValid() || bind(socket.Get(), reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0)
+        return {};
+    return socket;
+}
+
+// UDP socket sending multicast out of the interface with this address, looped
+// back to receivers on the same host. Invalid on failure, with errno set.
+inline FileDescriptor OpenMulticastSender(const std::string& interfaceAddress) {
+    sockaddr_in local;
+    if (!MakeSocketAddress(interfaceAddress, 0, local))
+        return {};
+    FileDescriptor socket{ ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0) };
+    unsigned char loop = 1, ttl = 1;
+    if (!socket.IsValid() ||
+        setsockopt(socket.Get(), IPPROTO_IP, IP_MULTICAST_IF, &local.sin_addr, sizeof(local.sin_addr)) != 0 ||
+        setsockopt(socket.Get(), IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) != 0 ||
+        setsockopt(socket.Get(), IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) != 0)
+        return {};
+    return socket;
+}
+
+// Nonblocking UDP socket joined to group:port on the interface with this address.
+// Invalid on failure, with errno set.
+inline FileDescriptor OpenMulticastReceiver(const std::string& group, std::uint16_t port,
+                                            const std::string& interfaceAddress,
+                                            int receiveBuffer = 1 << 22) {
+    sockaddr_in local, interface;
+    if (!MakeSocketAddress(group, port, local) || !MakeSocketAddress(interfaceAddress, 0, interface))
+        return {};
+    ip_mreq membership{ local.sin_addr, interface.sin_addr };
+    FileDescriptor socket{ ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0) };
+    int reuse = 1;
+    if (!socket.IsValid() ||
+        setsockopt(socket.Get(), SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        setsockopt(socket.Get(), SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer)) != 0 ||
+        bind(socket.Get(), reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 ||
+        setsockopt(socket.Get(), IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0)
+        return {};
+    return socket;
+}
+
+struct MarketDataConfig {
+    std::string group{"239.1.1.1"};
+    std::uint16_t incrementalPort{31'000};
+    std::uint16_t snapshotPort{31'001};
+    std::string interfaceAddress{"127.0.0.1"};
+    std::uint16_t requestPort{31'002};          // Unicast on interfaceAddress; 0 picks a free one
+    std::size_t maxDatagram{1'472};             // Ethernet MTU less the IPv4 and UDP headers
+    std::chrono::nanoseconds conflationInterval{0}; // Least time between publications; 0 publishes every call
+};
+
+// Changes held back between publications of a conflated feed: the latest quantity
+// of each level changed and the volume traded at each price, in the order each
+// level or price was first touched. Repeated changes to one level cost a lookup
+// and no space.
+class MarketDataConflator {
+public:
+    bool IsEmpty() const { return entries_.empty(); }
+    // Changes absorbed into an entry already pending
+    std::uint64_t GetCoalescedCount() const { return coalesced_; }
+
+    void UpdateLevel(Side side, std::int32_t price, std::uint32_t quantity) {
+        Touch(side == Side::Buy ? Kind::Bid : Kind::Ask, price).quantity = quantity;
+    }
+
+    void AddTrade(std::int32_t price, std::uint32_t quantity) { Touch(Kind::Trade, price).quantity += quantity; }
+
+    // Hand every pending change over, trades first, then empty
+    template <typename OnLevel, typename OnTrade>
+    void Drain(OnLevel&& onLevel, OnTrade&& onTrade) {
+        for (const auto& entry : entries_) {
+            // A volume beyond one print's quantity field goes out as several
+            for (std::uint64_t volume = entry.quantity; entry.kind == Kind::Trade && volume > 0;) {
+                auto print = static_cast<std::uint32_t>(std::min<std::uint64_t>(volume, UINT32_MAX));
+                onTrade(entry.price, print);
+                volume -= print;
+            }
+        }
+        for (const auto& entry : entries_) {
+            if (entry.kind != Kind::Trade)
+                onLevel(entry.kind == Kind::Bid ? Side::Buy : Side::Sell, entry.price,
+                        static_cast<std::uint32_t>(entry.quantity));
+        }
+        entries_.clear();
+        index_.clear();
+    }
+
+private:
+    enum class Kind : std::uint8_t { Bid, Ask, Trade };
+
+    struct Entry {
+        Kind kind;
+        std::int32_t price;
+        std::uint64_t quantity;
+    };
+
+    Entry& Touch(Kind kind, std::int32_t price) {
+        auto key = static_cast<std::uint64_t>(kind) << 32 | static_cast<std::uint32_t>(price);
+        auto [slot, inserted] = index_.try_emplace(key, static_cast<std::uint32_t>(entries_.size()));
+        if (inserted)
+            entries_.push_back(Entry{ kind, price, 0 });
+        else
+            ++coalesced_;
+        return entries_[slot->second];
+    }
+
+    std::vector<Entry> entries_;
+    std::unordered_map<std::uint64_t, std::uint32_t> index_;  // Kind and price to entry
+    std::uint64_t coalesced_{0};
+};
+
+// Publishes a book's trades and level changes as they happen. Messages queued
+// during a burst are packed into as few datagrams as fit them and all sent with
+// one sendmmsg when the burst ends, so a burst of book events costs about one
+// packet per maxDatagram bytes and one syscall.
+//
+// The publisher keeps the levels it has published. Snapshots are built from those
+// rather than from the book, so each matches its lastSequence exactly.
+//
+// Sends never block: a datagram the socket buffer has no room for is dropped and
+// counted, and receivers see the gap and recover from a snapshot.
+//
+// With a conflation interval, publications are at least that far apart, for
+// subscribers that cannot keep up with every change. Trades and level updates in
+// between are held in a MarketDataConflator, and the book is diffed once per
+// publication, so a level that changed many times goes out once with its latest
+// quantity and the matcher does no more work than at full rate. A conflated trade
+// print is the volume traded at its price since the last publication. Snapshot
+// requests wait for the next publication, so snapshots still match their
+// lastSequence.
+class MarketDataPublisher {
+public:
+    static constexpr std::size_t MaxDatagrams = 64;     // Sent per sendmmsg
+
+    // Nullopt on failure, with errno set
+    static std::optional<MarketDataPublisher> Create(const MarketDataConfig& config) {
+        if (config.maxDatagram < PacketHeaderView::Length + SnapshotBeginLength ||
+            config.maxDatagram > 65'507) {
+            errno = EINVAL;
+            return std::nullopt;
+        }
+        MarketDataPublisher publisher{ config.maxDatagram, config.conflationInterval };
+        publisher.socket_ = OpenMulticastSender(config.interfaceAddress);
+        publisher.requests_ = OpenDatagramSocket(config.interfaceAddress, config.requestPort);
+        if (!publisher.socket_.IsValid() || !publisher.requests_.IsValid() ||
+            !MakeSocketAddress(config.group, config.incrementalPort, publisher.incremental_.destination) ||
+            !MakeSocketAddress(config.group, config.snapshotPort, publisher.snapshot_.destination))
+            return std::nullopt;
+        return publisher;
+    }
+
+    std::uint16_t GetRequestPort() const { return GetListenerPort(requests_); }
+    // Sequence of the last incremental message queued
+    std::uint64_t GetSequence() const { return incremental_.nextSequence - 1; }
+    std::uint64_t GetMessageCount() const { return messages_; }
+    std::uint64_t GetPacketCount() const { return packets_; }
+    std::uint64_t GetDroppedCount() const { return dropped_; }
+    std::uint64_t GetSnapshotCount() const { return snapshots_; }
+    std::uint64_t GetSyscallCount() const { return syscalls_; }
+    std::uint64_t GetPublicationCount() const { return publications_; }
+    const MarketDataConflator& GetConflator() const { return conflator_; }
+
+    // Queue the trades and every level change since the last publication, send
+    // them and answer snapshot requests; when conflating and the interval has not
+    // passed, only hold the trades back. False on a socket failure, with errno set.
+    template <typename Book>
+    bool Publish(const Book& book, std::span<const Trade> trades,
+                 std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        for (const auto& trade : trades)
+            PublishTrade(trade.GetPrice(), trade.GetBidTrade().quantity_);
+        if (!IsDue(now))
+            return true;
+        ++publications_;
+        Release();
+        book.GetOrderInfos(current_);
+        Diff<Side::Buy>(bids_, current_.GetBids());
+        Diff<Side::Sell>(asks_, current_.GetAsks());
+        bids_.assign(current_.GetBids().begin(), current_.GetBids().end());
+        asks_.assign(current_.GetAsks().begin(), current_.GetAsks().end());
+        Send(incremental_);
+        return Succeeded() && ServiceSnapshotRequests();
+    }
+
+    void PublishTrade(std::int32_t price, std::uint32_t quantity) {
+        if (conflationInterval_ > std::chrono::nanoseconds::zero())
+            conflator_.AddTrade(price, quantity);
+        else
+            QueueTrade(price, quantity);
+    }
+
+    // Queue one level's new aggregate quantity, 0 if it is gone
+    void PublishLevel(Side side, std::int32_t price, std::uint32_t quantity) {
+        auto& levels = side == Side::Buy ? bids_ : asks_;
+        auto level = std::lower_bound(levels.begin(), levels.end(), price, [side](const LevelInfo& info, std::int32_t p) {
+            return side == Side::Buy ? info.price > p : info.price < p;
+        });
+        bool found = level != levels.end() && level->price == price;
+        if (quantity == 0 && found)
+            levels.erase(level);
+        else if (quantity != 0 && found)
+            level->quantity = quantity;
+        else if (quantity != 0)
+            levels.insert(level, LevelInfo{ price, quantity });
+        if (conflationInterval_ > std::chrono::nanoseconds::zero())
+            conflator_.UpdateLevel(side, price, quantity);
+        else
+            QueueLevel(side, price, quantity);
+    }
+
+    // Send everything queued, and when conflating and the interval has passed,
+    // everything held back. False on a socket failure, with errno set.
+    bool Flush(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        if (!conflator_.IsEmpty() && IsDue(now))
+            Release();
+        Send(incremental_);
+        return Succeeded();
+    }
+
+    // Answer any snapshot requests received since the last call with one snapshot
+    // of the published levels. Call with nothing queued or held back, so that the
+    // snapshot's lastSequence has been sent. False on a socket failure, with errno
+    // set.
+    bool ServiceSnapshotRequests() {
+        bool requested = false;
+        std::array<std::byte, 256> request;
+        for (;;) {
+            ssize_t received = recv(requests_.Get(), request.data(), request.size(), 0);
+            ++syscalls_;
+            if (received < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            if (static_cast<std::size_t>(received) < MessageHeaderView::Length + SnapshotRequestView::BlockLength)
+                continue;
+            MessageHeaderView header{ request.data() };
+            requested |= header.GetSchemaId() == MarketDataSchemaId &&
+                         header.GetTemplateId() == static_cast<std::uint16_t>(MarketDataType::SnapshotRequest);
+        }
+        if (!requested)
+            return true;
+
+        MarketDataEncoder::EncodeSnapshotBegin(Reserve(snapshot_, SnapshotBeginLength), GetSequence(),
+                                               static_cast<std::uint32_t>(bids_.size()),
+                                               static_cast<std::uint32_t>(asks_.size()));
+        for (const auto& level : bids_)
+            QueueSnapshotLevel(Side::Buy, level);
+        for (const auto& level : asks_)
+            QueueSnapshotLevel(Side::Sell, level);
+        ++snapshots_;
+        Send(snapshot_);
+        return Succeeded();
+    }
+
+private:
+    static constexpr std::size_t LevelLength = MessageHeaderView::Length + LevelUpdateView::BlockLength;
+    static constexpr std::size_t TradePrintLength = MessageHeaderView::Length + TradePrintView::BlockLength;
+    static constexpr std::size_t SnapshotBeginLength = MessageHeaderView::Length + SnapshotBeginView::BlockLength;
+
+    // Datagrams queued on one channel, in fixed slots of maxDatagram bytes; the
+    // last one is still being filled
+    struct Channel {
+        Channel(MarketDataChannel id, std::size_t maxDatagram)
+                : id{id}, buffer(MaxDatagrams * maxDatagram) {}
+
+        MarketDataChannel id;
+        sockaddr_in destination{};
+        std::uint64_t nextSequence{1};
+        std::vector<std::byte> buffer;
+        std::array<std::size_t, MaxDatagrams> lengths{};
+        std::size_t datagrams{0};
+    };
+
+    MarketDataPublisher(std::size_t maxDatagram, std::chrono::nanoseconds conflationInterval)
+            : maxDatagram_{maxDatagram}, conflationInterval_{conflationInterval},
+              incremental_{MarketDataChannel::Incremental, maxDatagram},
+              snapshot_{MarketDataChannel::Snapshot, maxDatagram} {}
+
+    // Whether a publication may go out now, starting the next interval if so
+    bool IsDue(std::chrono::steady_clock::time_point now) {
+        if (conflationInterval_ <= std::chrono::nanoseconds::zero())
+            return true;
+        if (now - lastPublication_ < conflationInterval_)
+            return false;
+        lastPublication_ = now;
+        return true;
+    }
+
+    // Queue everything the conflator held back
+    void Release() {
+        conflator_.Drain([this](Side side, std::int32_t price, std::uint32_t quantity) {
+            QueueLevel(side, price, quantity);
+        }, [this](std::int32_t price, std::uint32_t quantity) { QueueTrade(price, quantity); });
+    }
+
+    // Merge two sides sorted best first, queueing each level added, changed or removed
+    template <Side S>
+    void Diff(const std::vector<LevelInfo>& before, const std::vector<LevelInfo>& after) {
+        auto better = [](std::int32_t a, std::int32_t b) { return S == Side::Buy ? a > b : a < b; };
+        std::size_t i = 0, j = 0;
+        while (i < before.size() || j < after.size()) {
+            if (j == after.size() || (i < before.size() && better(before[i].price, after[j].price))) {
+                QueueLevel(S, before[i++].price, 0);
+            } else if (i == before.size() || better(after[j].price, before[i].price)) {
+                QueueLevel(S, after[j].price, after[j].quantity);
+                ++j;
+            } else {
+                if (before[i].quantity != after[j].quantity)
+                    QueueLevel(S, after[j].price, after[j].quantity);
+                ++i;
+                ++j;
+            }
+        }
+    }
+
+    void QueueLevel(Side side, std::int32_t price, std::uint32_t quantity) {
+        MarketDataEncoder::EncodeLevel(Reserve(incremental_, LevelLength), MarketDataType::LevelUpdate, side, price,
+                                       quantity);
+    }
+
+    void QueueTrade(std::int32_t price, std::uint32_t quantity) {
+        MarketDataEncoder::EncodeTradePrint(Reserve(incremental_, TradePrintLength), price, quantity);
+    }
+
+    void QueueSnapshotLevel(Side side, const LevelInfo& level) {
+        MarketDataEncoder::EncodeLevel(Reserve(snapshot_, LevelLength), MarketDataType::SnapshotLevel, side, level.price,
+                                       level.quantity);
+    }
+
+    std::byte* GetDatagram(Channel& channel, std::size_t index) { return channel.buffer.data() + index * maxDatagram_; }
+
+    // Room for the next message of the channel, which takes the next sequence
+    // number: the end of the open datagram if it fits, else a new datagram, sending
+    // the queued ones first when every slot is taken
+    std::span<std::byte> Reserve(Channel& channel, std::size_t length) {
+        if (channel.datagrams == 0 || channel.lengths[channel.datagrams - 1] + length > maxDatagram_ ||
+            PacketHeaderView{ GetDatagram(channel, channel.datagrams - 1) }.GetMessageCount() ==
+                    std::numeric_limits<std::uint16_t>::max()) {
+            if (channel.datagrams == MaxDatagrams)
+                Send(channel);
+            channel.lengths[channel.datagrams] =
+                    MarketDataEncoder::EncodePacketHeader({ GetDatagram(channel, channel.datagrams), maxDatagram_ },
+                                                          channel.nextSequence, 0, channel.id);
+            ++channel.datagrams;
+        }
+        std::size_t last = channel.datagrams - 1;
+        std::byte* datagram = GetDatagram(channel, last);
+        LittleEndian::Store(datagram + 8, static_cast<std::uint16_t>(PacketHeaderView{ datagram }.GetMessageCount() + 1));
+        std::byte* message = datagram + channel.lengths[last];
+        channel.lengths[last] += length;
+        ++channel.nextSequence;
+        ++messages_;
+        return { message, length };
+    }
+
+    // Send the channel's queued datagrams, dropping those the socket has no room for.
+    // A failure is kept in error_ and reported by the next Flush.
+    void Send(Channel& channel) {
+        std::array<iovec, MaxDatagrams> vectors;
+        std::array<mmsghdr, MaxDatagrams> headers{};
+        for (std::size_t i = 0; i < channel.datagrams; ++i) {
+            vectors[i] = iovec{ GetDatagram(channel, i), channel.lengths[i] };
+            headers[i].msg_hdr.msg_name = &channel.destination;
+            headers[i].msg_hdr.msg_namelen = sizeof(channel.destination);
+            headers[i].msg_hdr.msg_iov = &vectors[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+        std::size_t sent = 0;
+        while (sent < channel.datagrams) {
+            int count = sendmmsg(socket_.Get(), headers.data() + sent, static_cast<unsigned>(channel.datagrams - sent),
+                                 MSG_DONTWAIT);
+            ++syscalls_;
+            if (count > 0) {
+                sent += static_cast<std::size_t>(count);
+                packets_ += static_cast<std::uint64_t>(count);
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                dropped_ += channel.datagrams - sent;
+                break;
+            } else if (errno != EINTR) {
+                error_ = errno;
+                break;
+            }
+        }
+        channel.datagrams = 0;
+    }
+
+    bool Succeeded() const {
+        if (error_ == 0)
+            return true;
+        errno = error_;
+        return false;
+    }
+
+    std::size_t maxDatagram_;
+    std::chrono::nanoseconds conflationInterval_;
+    std::chrono::steady_clock::time_point lastPublication_{};
+    MarketDataConflator conflator_;
+    FileDescriptor socket_;
+    FileDescriptor requests_;
+    Channel incremental_;
+    Channel snapshot_;
+    std::vector<LevelInfo> bids_;       // As published, best first
+    std::vector<LevelInfo> asks_;
+    OrderbookLevelInfos current_;
+    int error_{0};                      // Send failure while queueing
+    std::uint64_t messages_{0};
+    std::uint64_t packets_{0};
+    std::uint64_t dropped_{0};
+    std::uint64_t snapshots_{0};
+    std::uint64_t syscalls_{0};
+    std::uint64_t publications_{0};
+};
+
+// Aggregated levels of a book rebuilt from a market data feed, kept in the same
+// side containers as OrderBook: each side is a flat tick ladder with a bitmap of
+// occupied ticks, so applying an update and reading the best level are constant
+// time, and walking the depth is linear in the levels read.
+class L2Book {
+public:
+    // Set one level's aggregate quantity, 0 removing it
+    void Apply(Side side, std::int32_t price, std::uint32_t quantity) {
+        if (side == Side::Buy)
+            Set(bids_, price, quantity);
+        else
+            Set(asks_, price, quantity);
+    }
+
+    void Clear() {
+        bids_.clear();
+        asks_.clear();
+    }
+
+    std::size_t GetLevelCount(Side side) const { return side == Side::Buy ? bids_.size() : asks_.size(); }
+
+    std::optional<LevelInfo> GetBestBid() const { return Best(bids_); }
+    std::optional<LevelInfo> GetBestAsk() const { return Best(asks_); }
+
+    // Copies up to levels.size() of one side's best levels; returns how many
+    std::size_t GetLevelInfos(Side side, std::span<LevelInfo> levels) const {
+        return side == Side::Buy ? Copy(bids_, levels) : Copy(asks_, levels);
+    }
+
+    void GetOrderInfos(OrderbookLevelInfos& infos) const {
+        infos.Reset(bids_.size(), asks_.size());
+        for (const auto& level : bids_)
+            infos.PushBack(Side::Buy, LevelInfo{ level.price, level.quantity });
+        for (const auto& level : asks_)
+            infos.PushBack(Side::Sell, LevelInfo{ level.price, level.quantity });
+    }
+
+private:
+    template <typename Levels>
+    static void Set(Levels& levels, std::int32_t price, std::uint32_t quantity) {
+        if (quantity == 0)
+            levels.erase(price);
+        else
+            levels.Emplace(price).quantity = quantity;
+    }
+
+    template <typename Levels>
+    static std::optional<LevelInfo> Best(const Levels& levels) {
+        if (levels.empty())
+            return std::nullopt;
+        return LevelInfo{ levels.begin()->price, levels.begin()->quantity };
+    }
+
+    template <typename Levels>
+    static std::size_t Copy(const Levels& levels, std::span<LevelInfo> out) {
+        std::size_t count = 0;
+        for (auto level = levels.begin(); level != levels.end() && count < out.size(); ++level)
+            out[count++] = LevelInfo{ level->price, level->quantity };
+        return count;
+    }
+
+    SideBook<Side::Buy, PriceLevel> bids_;
+    SideBook<Side::Sell, PriceLevel> asks_;
+};
+
+// Receiving end of a MarketDataPublisher: joins the incremental and snapshot
+// channels and keeps an L2Book in step with the publisher's levels.
+//
+// Incremental packets are applied while their sequence numbers follow on. When
+// one is missing the client requests a snapshot, holds the incremental packets
+// that keep arriving, and once the snapshot is complete replays those after the
+// snapshot's lastSequence. A request that goes unanswered is repeated. Until then
+// the book is not synchronized and should not be read.
+class MarketDataClient {
+public:
+    static constexpr std::chrono::milliseconds RequestRetry{ 100 };
+    static constexpr std::size_t MaxHeldPackets = 4'096;   // Beyond this the oldest are dropped
+
+    // Incremental and snapshot port 0 pick free ones. Nullopt on failure, with
+    // errno set.
+    static std::optional<MarketDataClient> Create(const MarketDataConfig& config) {
+        MarketDataClient client;
+        client.incremental_ = OpenMulticastReceiver(config.group, config.incrementalPort, config.interfaceAddress);
+        client.snapshot_ = OpenMulticastReceiver(config.group, config.snapshotPort, config.interfaceAddress);
+        client.requests_ = FileDescriptor{ socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0) };
+        if (!client.incremental_.IsValid() || !client.snapshot_.IsValid() || !client.requests_.IsValid() ||
+            !MakeSocketAddress(config.interfaceAddress, config.requestPort, client.publisher_))
+            return std::nullopt;
+        return client;
+    }
+
+    const L2Book& GetBook() const { return *book_; }
+    std::uint16_t GetIncrementalPort() const { return GetListenerPort(incremental_); }
+    std::uint16_t GetSnapshotPort() const { return GetListenerPort(snapshot_); }
+    bool IsSynchronized() const { return synchronized_; }
+    // Sequence of the next incremental message expected
+    std::uint64_t GetNextSequence() const { return expected_; }
+    std::uint64_t GetGapCount() const { return gaps_; }
+    std::uint64_t GetSnapshotCount() const { return snapshots_; }
+    std::uint64_t GetTradeCount() const { return trades_; }
+    // Price and quantity of the latest trade print, if any
+    const std::optional<LevelInfo>& GetLastTrade() const { return lastTrade_; }
+
+    // Read and apply everything waiting on both channels. False on a socket
+    // failure, with errno set.
+    bool Poll(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        now_ = now;
+        if (!Drain(snapshot_, &MarketDataClient::OnSnapshot) || !Drain(incremental_, &MarketDataClient::OnIncremental))
+            return false;
+        if (!synchronized_ && now_ - lastRequest_ >= RequestRetry)
+            RequestSnapshot();
+        return requestError_ == 0 || Fail();
+    }
+
+    // Drop the book and rebuild it from a snapshot, as after a gap
+    void Resynchronize() {
+        synchronized_ = false;
+        snapshotRemaining_ = 0;
+        RequestSnapshot();
+    }
+
+    // Apply one incremental datagram, as read from the incremental channel
+    void OnIncremental(std::span<const std::byte> datagram) {
+        if (datagram.size() < PacketHeaderView::Length)
+            return;
+        if (!synchronized_) {
+            Hold(datagram);
+            return;
+        }
+        PacketHeaderView packet{ datagram.data() };
+        if (packet.GetSequence() > expected_) {
+            ++gaps_;
+            Hold(datagram);
+            Resynchronize();
+            return;
+        }
+        ApplyIncremental(datagram);
+    }
+
+    // Apply one snapshot datagram, as read from the snapshot channel. Ignored
+    // unless a snapshot is awaited.
+    void OnSnapshot(std::span<const std::byte> datagram) {
+        if (synchronized_ || datagram.size() < PacketHeaderView::Length)
+            return;
+        PacketHeaderView packet{ datagram.data() };
+        std::uint64_t sequence = packet.GetSequence();
+        // Levels of a snapshot whose start was missed are of no use
+        if (snapshotRemaining_ > 0 && sequence != snapshotNext_)
+            snapshotRemaining_ = 0;
+        ForEachMessage(datagram, [&](MessageHeaderView header, const std::byte* block) {
+            auto type = static_cast<MarketDataType>(header.GetTemplateId());
+            if (type == MarketDataType::SnapshotBegin && header.GetBlockLength() >= SnapshotBeginView::BlockLength) {
+                SnapshotBeginView begin{ block };
+                book_->Clear();
+                snapshotLast_ = begin.GetLastSequence();
+                snapshotRemaining_ = std::uint64_t{ begin.GetBidCount() } + begin.GetAskCount() + 1;
+            } else if (type == MarketDataType::SnapshotLevel && snapshotRemaining_ > 0 &&
+                       header.GetBlockLength() >= LevelUpdateView::BlockLength) {
+                LevelUpdateView level{ block };
+                book_->Apply(level.GetSide() == 0 ? Side::Buy : Side::Sell, level.GetPrice(), level.GetQuantity());
+            } else {
+                return;
+            }
+            if (--snapshotRemaining_ == 0)
+                Synchronize();
+        });
+        snapshotNext_ = sequence + packet.GetMessageCount();
+    }
+
+private:
+    MarketDataClient() : buffer_(1 << 16), book_{std::make_unique<L2Book>()} {}
+
+    template <typename OnMessage>
+    static void ForEachMessage(std::span<const std::byte> datagram, OnMessage&& onMessage) {
+        PacketHeaderView packet{ datagram.data() };
+        std::size_t offset = PacketHeaderView::Length;
+        for (std::uint16_t i = 0; i < packet.GetMessageCount(); ++i) {
+            if (datagram.size() - offset < MessageHeaderView::Length)
+                return;
+            MessageHeaderView header{ datagram.data() + offset };
+            std::size_t length = MessageHeaderView::Length + header.GetBlockLength();
+            if (datagram.size() - offset < length)
+                return;
+            if (header.GetSchemaId() == MarketDataSchemaId)
+                onMessage(header, datagram.data() + offset + MessageHeaderView::Length);
+            offset += length;
+        }
+    }
+
+    bool Drain(const FileDescriptor& socket, void (MarketDataClient::*onDatagram)(std::span<const std::byte>)) {
+        for (;;) {
+            ssize_t received = recv(socket.Get(), buffer_.data(), buffer_.size(), 0);
+            if (received >= 0)
+                (this->*onDatagram)({ buffer_.data(), static_cast<std::size_t>(received) });
+            else if (errno != EINTR)
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+
+    // Apply the messages of a packet not before the next expected, which must not
+    // start after it
+    void ApplyIncremental(std::span<const std::byte> datagram) {
+        std::uint64_t sequence = PacketHeaderView{ datagram.data() }.GetSequence();
+        ForEachMessage(datagram, [&](MessageHeaderView header, const std::byte* block) {
+            if (sequence++ < expected_)
+                return;
+            auto type = static_cast<MarketDataType>(header.GetTemplateId());
+            if (type == MarketDataType::LevelUpdate && header.GetBlockLength() >= LevelUpdateView::BlockLength) {
+                LevelUpdateView level{ block };
+                book_->Apply(level.GetSide() == 0 ? Side::Buy : Side::Sell, level.GetPrice(), level.GetQuantity());
+            } else if (type == MarketDataType::TradePrint && header.GetBlockLength() >= TradePrintView::BlockLength) {
+                TradePrintView print{ block };
+                lastTrade_ = LevelInfo{ print.GetPrice(), print.GetQuantity() };
+                ++trades_;
+            }
+            ++expected_;
+        });
+    }
+
+    void Hold(std::span<const std::byte> datagram) {
+        if (held_.size() == MaxHeldPackets)
+            held_.erase(held_.begin());
+        held_.emplace_back(datagram.begin(), datagram.end());
+    }
+
+    // The snapshot is complete: replay the held packets that follow it, or ask
+    // again if one that should is missing
+    void Synchronize() {
+        synchronized_ = true;
+        expected_ = snapshotLast_ + 1;
+        ++snapshots_;
+        std::sort(held_.begin(), held_.end(), [](const auto& a, const auto& b) {
+            return PacketHeaderView{ a.data() }.GetSequence() < PacketHeaderView{ b.data() }.GetSequence();
+        });
+        for (const auto& datagram : held_) {
+            PacketHeaderView packet{ datagram.data() };
+            if (packet.GetSequence() > expected_) {
+                ++gaps_;
+                synchronized_ = false;
+                break;
+            }
+            ApplyIncremental(datagram);
+        }
+        if (synchronized_)
+            held_.clear();
+        else
+            // Keep only what a later snapshot could still need
+            std::erase_if(held_, [this](const auto& datagram) {
+                PacketHeaderView packet{ datagram.data() };
+                return packet.GetSequence() + packet.GetMessageCount() <= expected_;
+            });
+        if (!synchronized_)
+            RequestSnapshot();
+    }
+
+    void RequestSnapshot() {
+        std::array<std::byte, MessageHeaderView::Length + SnapshotRequestView::BlockLength> request;
+        MarketDataEncoder::EncodeSnapshotRequest(request, expected_);
+        lastRequest_ = now_;
+        if (sendto(requests_.Get(), request.data(), request.size(), 0, reinterpret_cast<const sockaddr*>(&publisher_),
+                   sizeof(publisher_)) < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS &&
+            errno != ECONNREFUSED)
+            requestError_ = errno;
+    }
+
+    bool Fail() const {
+        errno = requestError_;
+        return false;
+    }
+
+    FileDescriptor incremental_;
+    FileDescriptor snapshot_;
+    FileDescriptor requests_;
+    sockaddr_in publisher_{};
+    std::vector<std::byte> buffer_;
+    std::unique_ptr<L2Book> book_;                  // Large, and its levels must not move
+    bool synchronized_{false};
+    std::uint64_t expected_{1};
+    std::vector<std::vector<std::byte>> held_;      // Incremental packets received while not synchronized
+    std::uint64_t snapshotLast_{0};
+    std::uint64_t snapshotNext_{0};                 // Sequence the next packet of the snapshot must carry
+    std::uint64_t snapshotRemaining_{0};            // Messages left of the snapshot being read, 0 if none
+    std::chrono::steady_clock::time_point now_{};
+    std::chrono::steady_clock::time_point lastRequest_{};
+    int requestError_{0};
+    std::uint64_t gaps_{0};
+    std::uint64_t snapshots_{0};
+    std::uint64_t trades_{0};
+    std::optional<LevelInfo> lastTrade_;
+};
@@ -0,0 +1,1846 @@
+#pragma once
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <list>
+#include <cmath>
+#include <ctime>
+#include <deque>
+#include <queue>
+#include <stack>
+#include <limits>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <variant>
+#include <optional>
+#include <tuple>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <span>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(ORDERBOOK_SCALAR_KERNELS)
+#define ORDERBOOK_X86_KERNELS
+#include <immintrin.h>
+#endif
+#ifndef ORDERBOOK_NO_EXCEPTIONS
+#include <format>
+#include <stdexcept>
+#endif
+
+// Order types and sides.
+enum class OrderType {
+    GoodTillCancel,
+    FillAndKill,
+    GoodTillDate,   // Expires at the order's own expiry time
+    GoodForDay      // Expires at the book's end of day
+};
+
+enum class Side {
+    Buy,
+    Sell
+};
+
+// What to do when both sides of a would-be trade belong to the same owner
+enum class SelfTradePrevention {
+    None,           // Allow the trade
+    CancelNewest,   // Cancel the incoming (aggressing) order
+    CancelOldest,   // Cancel the resting order
+    CancelBoth,     // Cancel both orders
+    Decrement       // Reduce both by the smaller quantity without trading
+};
+
+// Owner id 0 marks anonymous orders, which are never checked for self-trades
+constexpr std::uint32_t AnonymousOwner = 0;
+
+// Book time in caller-defined ticks (e.g. milliseconds since midnight)
+using Timestamp = std::uint64_t;
+constexpr Timestamp NoExpiry = std::numeric_limits<Timestamp>::max();
+
+// Outcome of a book operation
+enum class OrderStatus : std::uint8_t {
+    Accepted,
+    DuplicateId,        // An order with this id is already resting
+    UnknownId,          // No resting order has this id
+    WouldNotMatch,      // FillAndKill that cannot trade now
+    InvalidQuantity,    // Zero quantity
+    Expired,            // Expiry is not after the book's current time
+    InvalidCommand      // Side, type or command kind out of range; from gateways only
+};
+
+// Counters for rejected operations and failed internal checks
+struct OrderBookStats {
+    std::uint64_t rejected{0};
+    std::uint64_t verificationFailures{0};
+};
+
+// Holds price and aggregated quantity at a given level
+struct LevelInfo {
+    std::int32_t price;
+    std::uint32_t quantity;
+};
+
+// Aggregated order book levels. A snapshot kept by the caller can be refilled in
+// place, reusing its buffers once they have grown to the book's depth.
+class OrderbookLevelInfos {
+public:
+    OrderbookLevelInfos() = default;
+    OrderbookLevelInfos(std::vector<LevelInfo> bids, std::vector<LevelInfo> asks)
+            : bids_{std::move(bids)}, asks_{std::move(asks)} {}
+
+    const std::vector<LevelInfo>& GetBids() const { return bids_; }
+    const std::vector<LevelInfo>& GetAsks() const { return asks_; }
+
+    // Empty both sides, keeping room for the given number of levels
+    void Reset(std::size_t bidLevels, std::size_t askLevels) {
+        bids_.clear();
+        asks_.clear();
+        bids_.reserve(bidLevels);
+        asks_.reserve(askLevels);
+    }
+
+    void PushBack(Side side, LevelInfo level) { (side == Side::Buy ? bids_ : asks_).push_back(level); }
+
+private:
+    std::vector<LevelInfo> bids_;
+    std::vector<LevelInfo> asks_;
+};
+
+// Represents an individual order
+class Order {
+public:
+    Order(OrderType orderType, std::uint64_t orderId, Side side, std::int32_t price, std::uint32_t quantity,
+          std::uint32_t ownerId = AnonymousOwner, Timestamp expiry = NoExpiry)
+            : orderType_{orderType}, orderId_{orderId}, side_{side}, price_{price},
+              initialQuantity_{quantity}, remainingQuantity_{quantity}, ownerId_{ownerId}, expiry_{expiry} {}
+
+    OrderType GetOrderType() const { return orderType_; }
+    std::uint64_t GetOrderId() const { return orderId_; }
+    Side GetSide() const { return side_; }
+    std::int32_t GetPrice() const { return price_; }
+    std::uint32_t GetInitialQuantity() const { return initialQuantity_; }
+    std::uint32_t GetRemainingQuantity() const { return remainingQuantity_; }
+    std::uint32_t GetFilledQuantity() const { return initialQuantity_ - remainingQuantity_; }
+    std::uint32_t GetOwnerId() const { return ownerId_; }
+    Timestamp GetExpiry() const { return expiry_; }
+    bool isFilled() const { return remainingQuantity_ == 0; }
+
+    // Fill part of the order. Overfilling throws, or with ORDERBOOK_NO_EXCEPTIONS
+    // leaves the order untouched and returns false for the caller to count.
+    bool Fill(std::uint32_t quantity) {
+        if (quantity > remainingQuantity_) [[unlikely]] {
+#ifdef ORDERBOOK_NO_EXCEPTIONS
+            return false;
+#else
+            throw std::logic_error(std::format("Order ({}) cannot be filled for more than its remaining quantity", orderId_));
+#endif
+        }
+        remainingQuantity_ -= quantity;
+        return true;
+    }
+
+private:
+    OrderType orderType_;
+    std::uint64_t orderId_;
+    Side side_;
+    std::int32_t price_;
+    std::uint32_t initialQuantity_;
+    std::uint32_t remainingQuantity_;
+    std::uint32_t ownerId_;
+    Timestamp expiry_;
+};
+
+// Represents a modification request for an existing order
+class OrderModify {
+public:
+    OrderModify(std::uint64_t orderId, Side side, std::int32_t price, std::uint32_t quantity)
+            : orderId_{orderId}, side_{side}, price_{price}, quantity_{quantity} {}
+
+    std::uint64_t GetOrderId() const { return orderId_; }
+    Side GetSide() const { return side_; }
+    std::int32_t GetPrice() const { return price_; }
+    std::uint32_t GetQuantity() const { return quantity_; }
+
+    // Create a new Order with the given type, keeping the original owner and expiry
+    std::shared_ptr<Order> ToOrderPointer(OrderType type, std::uint32_t ownerId, Timestamp expiry) const {
+        return std::make_shared<Order>(type, orderId_, side_, price_, quantity_, ownerId, expiry);
+    }
+
+private:
+    std::uint64_t orderId_;
+    Side side_;
+    std::int32_t price_;
+    std::uint32_t quantity_;
+};
+
+// Holds trade details. price_ is the order's own limit price.
+struct TradeInfo {
+    std::uint64_t order_id;
+    std::int32_t price_;
+    std::uint32_t quantity_;
+    std::uint32_t owner_id;     // For routing the fill back to the order's session
+};
+
+// Represents a trade between a bid and an ask, at the execution price: the resting
+// order's price in continuous trading, the clearing price in an auction
+class Trade {
+public:
+    Trade(const TradeInfo& bidTrade, const TradeInfo& askTrade, std::int32_t price)
+            : bidTrade_{bidTrade}, askTrade_{askTrade}, price_{price} {}
+
+    const TradeInfo& GetBidTrade() const { return bidTrade_; }
+    const TradeInfo& GetAskTrade() const { return askTrade_; }
+    std::int32_t GetPrice() const { return price_; }
+
+private:
+    TradeInfo bidTrade_;
+    TradeInfo askTrade_;
+    std::int32_t price_;
+};
+
+// Hierarchical timing wheel: four levels of 256 slots, each slot spanning 256 times
+// the one below, plus an overflow list. Scheduling is O(1), a timer cascades down
+// at most four times, and everything due in a tick is handed back as one batch.
+class TimerWheel {
+public:
+    struct Timer {
+        std::uint64_t id;
+        std::uint64_t tag;      // Caller's check that the timer still refers to the same object
+        Timestamp expiry;
+    };
+
+    explicit TimerWheel(Timestamp now = 0) : now_{now} {}
+
+    Timestamp Now() const { return now_; }
+    std::size_t Size() const { return size_; }
+
+    // Timers that are already due fire on the next Advance
+    void Schedule(const Timer& timer) {
+        ++size_;
+        if (timer.expiry <= now_)
+            due_.push_back(timer);
+        else
+            Place(timer);
+    }
+
+    // Move the clock forward, appending every timer with expiry <= now
+    void Advance(Timestamp now, std::vector<Timer>& expired) {
+        size_ -= due_.size();
+        expired.insert(expired.end(), due_.begin(), due_.end());
+        due_.clear();
+
+        while (now_ < now) {
+            if (size_ == 0) {
+                now_ = now;
+                break;
+            }
+
+            // Skip straight to the next boundary of the lowest occupied level
+            std::size_t level = 0;
+            while (counts_[level] == 0)
+                ++level;
+            if (level > 0) {
+                Timestamp boundary = now_ | ((Timestamp{1} << (SlotBits * level)) - 1);
+                if (boundary >= now) {
+                    now_ = now;
+                    break;
+                }
+                now_ = boundary;
+            }
+            Tick(expired);
+        }
+    }
+
+private:
+    static constexpr std::size_t Levels = 4;
+    static constexpr std::size_t SlotBits = 8;
+    static constexpr std::size_t Slots = std::size_t{1} << SlotBits;
+    static constexpr Timestamp SlotMask = Slots - 1;
+
+    std::vector<Timer> slots_[Levels][Slots];
+    std::vector<Timer> overflow_;
+    std::vector<Timer> due_;
+    std::size_t counts_[Levels + 1]{};   // Timers per level, overflow last
+    std::size_t size_{0};
+    Timestamp now_;
+
+    // File a future timer at the coarsest level whose slot still separates it from now
+    void Place(const Timer& timer) {
+        Timestamp distance = timer.expiry ^ now_;
+        for (std::size_t level = 0; level < Levels; ++level) {
+            if (distance >> (SlotBits * (level + 1)) == 0) {
+                slots_[level][(timer.expiry >> (SlotBits * level)) & SlotMask].push_back(timer);
+                ++counts_[level];
+                return;
+            }
+        }
+        overflow_.push_back(timer);
+        ++counts_[Levels];
+    }
+
+    // Re-file every timer in a slot one or more levels down
+    void Cascade(std::vector<Timer>& slot, std::size_t& count) {
+        std::vector<Timer> timers;
+        timers.swap(slot);
+        count -= timers.size();
+        for (const auto& timer : timers)
+            Place(timer);
+    }
+
+    void Tick(std::vector<Timer>& expired) {
+        ++now_;
+
+        // Cascade coarser levels whose slot boundary was just crossed, highest first
+        if ((now_ & SlotMask) == 0) {
+            std::size_t top = 1;
+            while (top < Levels && ((now_ >> (SlotBits * top)) & SlotMask) == 0)
+                ++top;
+            if (top == Levels)
+                Cascade(overflow_, counts_[Levels]);
+            for (std::size_t level = std::min(top, Levels - 1); level > 0; --level)
+                Cascade(slots_[level][(now_ >> (SlotBits * level)) & SlotMask], counts_[level]);
+        }
+
+        auto& slot = slots_[0][now_ & SlotMask];
+        counts_[0] -= slot.size();
+        size_ -= slot.size();
+        expired.insert(expired.end(), slot.begin(), slot.end());
+        slot.clear();
+    }
+};
+
+// Continuous matching, or a call phase that only accumulates orders until uncrossed
+enum class TradingPhase {
+    Continuous,
+    Auction
+};
+
+// Equilibrium of a call auction at the price that maximises executable volume
+struct AuctionUncross {
+    std::int32_t price;
+    std::uint64_t volume;
+    std::int64_t imbalance;   // Buy surplus (positive) or sell surplus (negative) at price
+};
+
+// How resting quantity at a price level is allocated to an incoming order
+enum class MatchingPolicy {
+    Fifo,           // Strict price-time priority
+    ProRata,        // In proportion to each resting order's size
+    FifoProRata     // Oldest order at the level first, the remainder pro-rata
+};
+
+// Fields of a resting order that matching never reads
+struct OrderDetails {
+    OrderType type;
+    std::uint32_t initialQuantity;
+    Timestamp expiry;           // As submitted
+    std::uint64_t sequence;     // Arrival order, to tell newest from oldest outside continuous matching
+};
+
+// Time-priority queue of the orders resting at one price, stored as parallel
+// arrays so fills and scans stream through contiguous memory. The matching loop
+// touches only the hot arrays, 16 bytes per order (id, open quantity, owner);
+// the cold OrderDetails sit in their own array at the same position. Removed
+// orders become tombstones (zero quantity) that the front skips and Compact squeezes out.
+class OrderQueue {
+public:
+    // Position of an order in the queue; changes only when the queue is compacted
+    using Handle = std::uint32_t;
+
+    bool Empty() const { return live_ == 0; }
+    std::size_t Size() const { return live_; }
+
+    // Oldest live order, if not empty, and the end of the scan range
+    Handle Front() const { return head_; }
+    Handle End() const { return static_cast<Handle>(quantities_.size()); }
+    bool IsLive(Handle handle) const { return quantities_[handle] != 0; }
+
+    std::uint64_t GetOrderId(Handle handle) const { return orderIds_[handle]; }
+    std::uint32_t GetQuantity(Handle handle) const { return quantities_[handle]; }
+    std::uint32_t GetOwnerId(Handle handle) const { return ownerIds_[handle]; }
+    const OrderDetails& GetDetails(Handle handle) const { return details_[handle]; }
+
+    Handle PushBack(std::uint64_t orderId, std::uint32_t quantity, std::uint32_t ownerId, const OrderDetails& details) {
+        orderIds_.push_back(orderId);
+        quantities_.push_back(quantity);
+        ownerIds_.push_back(ownerId);
+        details_.push_back(details);
+        ++live_;
+        return End() - 1;
+    }
+
+    // Reduce an order's quantity; an overfill is refused and reported as false
+    bool Fill(Handle handle, std::uint32_t quantity) {
+        if (quantity > quantities_[handle]) [[unlikely]]
+            return false;
+        quantities_[handle] -= quantity;
+        return true;
+    }
+
+    // Turn an order into a tombstone
+    void Erase(Handle handle) {
+        quantities_[handle] = 0;
+        --live_;
+        while (head_ < End() && quantities_[head_] == 0)
+            ++head_;
+    }
+
+    // Worth compacting once tombstones outnumber live orders
+    bool NeedsCompaction() const {
+        std::size_t dead = quantities_.size() - live_;
+        return dead >= MinCompaction && dead > live_;
+    }
+
+    // Squeeze out tombstones; relocate(orderId, handle) is told every order that moves.
+    // Invalidates handles, so never call it while a scan of the queue is in progress.
+    template <typename Relocate>
+    void Compact(Relocate&& relocate) {
+        Handle target = 0;
+        for (Handle handle = head_; handle < End(); ++handle) {
+            if (quantities_[handle] == 0)
+                continue;
+            if (handle != target) {
+                orderIds_[target] = orderIds_[handle];
+                quantities_[target] = quantities_[handle];
+                ownerIds_[target] = ownerIds_[handle];
+                details_[target] = details_[handle];
+                relocate(orderIds_[target], target);
+            }
+            ++target;
+        }
+        orderIds_.resize(target);
+        quantities_.resize(target);
+        ownerIds_.resize(target);
+        details_.resize(target);
+        head_ = 0;
+    }
+
+    // Drop every order, keeping the storage for reuse
+    void Clear() {
+        orderIds_.clear();
+        quantities_.clear();
+        ownerIds_.clear();
+        details_.clear();
+        head_ = 0;
+        live_ = 0;
+    }
+
+private:
+    static constexpr std::size_t MinCompaction = 32;
+
+    std::vector<std::uint64_t> orderIds_;
+    std::vector<std::uint32_t> quantities_;
+    std::vector<std::uint32_t> ownerIds_;
+    std::vector<OrderDetails> details_;
+    Handle head_{0};
+    std::size_t live_{0};
+};
+
+// Orders resting at a single price, with their total remaining quantity cached
+struct OrderLevel {
+    std::int32_t price;
+    std::uint32_t quantity{0};
+    OrderQueue orders;
+
+    // Empty the level, keeping the queue's storage for reuse
+    void Clear() {
+        quantity = 0;
+        orders.Clear();
+    }
+};
+
+// Aggregate quantity at a single price, for books that see no individual orders,
+// such as one rebuilt from market data
+struct PriceLevel {
+    std::int32_t price;
+    std::uint32_t quantity{0};
+
+    void Clear() { quantity = 0; }
+};
+
+// Set of ticks in a window of up to 64^3, as three levels of 64-bit words: a bit
+// in an upper level is set while the word it summarises is non-zero, so finding
+// the nearest set tick in either direction is one tzcnt or lzcnt per level.
+template <std::uint32_t Ticks>
+class PriceBitmap {
+    static_assert(Ticks % (64 * 64) == 0 && Ticks <= 64 * 64 * 64);
+
+public:
+    static constexpr std::uint32_t None = Ticks;
+
+    bool Empty() const { return top_ == 0; }
+
+    void Set(std::uint32_t tick) {
+        leaves_[tick >> 6] |= Bit(tick & 63);
+        middle_[tick >> 12] |= Bit(tick >> 6 & 63);
+        top_ |= Bit(tick >> 12);
+    }
+
+    void Reset(std::uint32_t tick) {
+        if ((leaves_[tick >> 6] &= ~Bit(tick & 63)) != 0)
+            return;
+        if ((middle_[tick >> 12] &= ~Bit(tick >> 6 & 63)) != 0)
+            return;
+        top_ &= ~Bit(tick >> 12);
+    }
+
+    // Lowest set tick at or above tick, or None
+    std::uint32_t Next(std::uint32_t tick) const {
+        if (tick >= Ticks)
+            return None;
+        std::uint32_t leaf = tick >> 6;
+        if (std::uint64_t word = leaves_[leaf] & AtOrAbove(tick & 63))
+            return leaf << 6 | Lowest(word);
+        std::uint32_t middle = leaf >> 6;
+        if (std::uint64_t word = middle_[middle] & Above(leaf & 63))
+            return LowestIn(middle << 6 | Lowest(word));
+        if (std::uint64_t word = top_ & Above(middle)) {
+            middle = Lowest(word);
+            return LowestIn(middle << 6 | Lowest(middle_[middle]));
+        }
+        return None;
+    }
+
+    // Highest set tick at or below tick, or None
+    std::uint32_t Previous(std::uint32_t tick) const {
+        if (tick >= Ticks)
+            return None;
+        std::uint32_t leaf = tick >> 6;
+        if (std::uint64_t word = leaves_[leaf] & AtOrBelow(tick & 63))
+            return leaf << 6 | Highest(word);
+        std::uint32_t middle = leaf >> 6;
+        if (std::uint64_t word = middle_[middle] & Below(leaf & 63))
+            return HighestIn(middle << 6 | Highest(word));
+        if (std::uint64_t word = top_ & Below(middle)) {
+            middle = Highest(word);
+            return HighestIn(middle << 6 | Highest(middle_[middle]));
+        }
+        return None;
+    }
+
+private:
+    static constexpr std::uint64_t Bit(std::uint32_t i) { return std::uint64_t{1} << i; }
+    static constexpr std::uint64_t AtOrAbove(std::uint32_t i) { return ~std::uint64_t{0} << i; }
+    static constexpr std::uint64_t Above(std::uint32_t i) { return i == 63 ? 0 : AtOrAbove(i + 1); }
+    static constexpr std::uint64_t AtOrBelow(std::uint32_t i) { return ~std::uint64_t{0} >> (63 - i); }
+    static constexpr std::uint64_t Below(std::uint32_t i) { return i == 0 ? 0 : AtOrBelow(i - 1); }
+    static std::uint32_t Lowest(std::uint64_t word) { return static_cast<std::uint32_t>(std::countr_zero(word)); }
+    static std::uint32_t Highest(std::uint64_t word) { return 63 - static_cast<std::uint32_t>(std::countl_zero(word)); }
+
+    std::uint32_t LowestIn(std::uint32_t leaf) const { return leaf << 6 | Lowest(leaves_[leaf]); }
+    std::uint32_t HighestIn(std::uint32_t leaf) const { return leaf << 6 | Highest(leaves_[leaf]); }
+
+    std::uint64_t top_{0};
+    std::array<std::uint64_t, Ticks / 4096> middle_{};
+    std::array<std::uint64_t, Ticks / 64> leaves_{};
+};
+
+// Price levels of one side, best first. The side is a template parameter that fixes
+// the price priority.
+//
+// Levels within a window of ticks sit in a flat ladder indexed by price, with a
+// bitmap of the non-empty ticks, so finding a level and advancing to the next best
+// one after a sweep are constant time however wide the gaps. The window is placed
+// around the first price of an empty book; levels outside it fall back to a map.
+// Level addresses are stable until the level is erased.
+//
+// Level is OrderLevel for the matching book, or any type with a price, a quantity
+// and a Clear() that empties it when it is recycled, such as PriceLevel.
+template <Side S, typename Level = OrderLevel>
+class SideBook {
+    using Compare = std::conditional_t<S == Side::Buy, std::greater<std::int32_t>, std::less<std::int32_t>>;
+    using Overflow = std::map<std::int32_t, Level, Compare>;
+
+public:
+    static constexpr std::uint32_t WindowTicks = 1 << 16;
+
+    // Walks levels in priority order: overflow levels better than the window, the
+    // window, then overflow levels worse than it. Inside the window the overflow
+    // position is already the first of the worse levels.
+    template <bool Const>
+    class Iterator {
+        using Book = std::conditional_t<Const, const SideBook, SideBook>;
+        using OverflowIterator = std::conditional_t<Const, typename Overflow::const_iterator, typename Overflow::iterator>;
+        using Value = std::conditional_t<Const, const Level, Level>;
+
+    public:
+        Value& operator*() const { return segment_ == Segment::Window ? *book_->slots_[tick_] : overflow_->second; }
+        Value* operator->() const { return &**this; }
+
+        Iterator& operator++() {
+            if (segment_ == Segment::Window)
+                tick_ = book_->NextTick(tick_);
+            else
+                ++overflow_;
+            return Settle();
+        }
+
+        bool operator==(const Iterator& other) const {
+            return segment_ == other.segment_ &&
+                   (segment_ == Segment::Window ? tick_ == other.tick_ : overflow_ == other.overflow_);
+        }
+
+    private:
+        friend class SideBook;
+        enum class Segment { Before, Window, After };
+
+        Iterator(Book* book, Segment segment, OverflowIterator overflow, std::uint32_t tick = 0)
+                : book_{book}, segment_{segment}, overflow_{overflow}, tick_{tick} {}
+
+        Iterator& Settle() {
+            if (segment_ == Segment::Before &&
+                (overflow_ == book_->overflow_.end() || !book_->BeforeWindow(overflow_->first))) {
+                segment_ = Segment::Window;
+                tick_ = book_->BestTick();
+            }
+            if (segment_ == Segment::Window && tick_ == Bitmap::None)
+                segment_ = Segment::After;
+            return *this;
+        }
+
+        Book* book_;
+        Segment segment_;
+        OverflowIterator overflow_;
+        std::uint32_t tick_;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    SideBook() : slots_(WindowTicks, nullptr) {}
+    SideBook(const SideBook&) = delete;
+    SideBook& operator=(const SideBook&) = delete;
+
+    iterator begin() { return iterator{ this, iterator::Segment::Before, overflow_.begin() }.Settle(); }
+    iterator end() { return iterator{ this, iterator::Segment::After, overflow_.end() }; }
+    const_iterator begin() const { return const_iterator{ this, const_iterator::Segment::Before, overflow_.begin() }.Settle(); }
+    const_iterator end() const { return const_iterator{ this, const_iterator::Segment::After, overflow_.end() }; }
+
+    bool empty() const { return windowLevels_ == 0 && overflow_.empty(); }
+    std::size_t size() const { return windowLevels_ + overflow_.size(); }
+
+    // The level at price, created empty if there is none
+    Level& Emplace(std::int32_t price) {
+        if (empty())
+            base_ = static_cast<std::int64_t>(price) - WindowTicks / 2;
+        if (!InWindow(price))
+            return overflow_.try_emplace(price, MakeLevel(price)).first->second;
+        Level*& slot = slots_[Tick(price)];
+        if (slot == nullptr) {
+            slot = Acquire(price);
+            ticks_.Set(Tick(price));
+            ++windowLevels_;
+        }
+        return *slot;
+    }
+
+    iterator erase(iterator it) {
+        iterator next = it;
+        ++next;
+        if (it.segment_ == iterator::Segment::Window) {
+            Release(slots_[it.tick_]);
+            slots_[it.tick_] = nullptr;
+            ticks_.Reset(it.tick_);
+            --windowLevels_;
+        } else {
+            overflow_.erase(it.overflow_);
+        }
+        return next;
+    }
+
+    iterator erase(iterator first, iterator last) {
+        while (first != last)
+            first = erase(first);
+        return last;
+    }
+
+    void erase(std::int32_t price) {
+        if (!InWindow(price))
+            overflow_.erase(price);
+        else if (slots_[Tick(price)] != nullptr)
+            erase(iterator{ this, iterator::Segment::Window, overflow_.end(), Tick(price) });
+    }
+
+    void clear() { erase(begin(), end()); }
+
+    // Levels priced within [minPrice, maxPrice], in priority order
+    std::pair<iterator, iterator> Range(std::int32_t minPrice, std::int32_t maxPrice) {
+        if constexpr (S == Side::Buy)
+            return { AtOrWorse(maxPrice),
+                     minPrice == std::numeric_limits<std::int32_t>::min() ? end() : AtOrWorse(minPrice - 1) };
+        else
+            return { AtOrWorse(minPrice),
+                     maxPrice == std::numeric_limits<std::int32_t>::max() ? end() : AtOrWorse(maxPrice + 1) };
+    }
+
+private:
+    using Bitmap = PriceBitmap<WindowTicks>;
+
+    bool InWindow(std::int32_t price) const {
+        return price >= base_ && price < base_ + WindowTicks;
+    }
+
+    bool BeforeWindow(std::int32_t price) const {
+        return S == Side::Buy ? price >= base_ + WindowTicks : price < base_;
+    }
+
+    std::uint32_t Tick(std::int32_t price) const { return static_cast<std::uint32_t>(price - base_); }
+
+    std::uint32_t BestTick() const {
+        return S == Side::Buy ? ticks_.Previous(WindowTicks - 1) : ticks_.Next(0);
+    }
+
+    std::uint32_t NextTick(std::uint32_t tick) const {
+        if constexpr (S == Side::Buy)
+            return tick == 0 ? Bitmap::None : ticks_.Previous(tick - 1);
+        else
+            return ticks_.Next(tick + 1);
+    }
+
+    // First level priced at or worse than price
+    iterator AtOrWorse(std::int32_t price) {
+        auto overflow = overflow_.lower_bound(price);
+        if (InWindow(price)) {
+            std::uint32_t tick = S == Side::Buy ? ticks_.Previous(Tick(price)) : ticks_.Next(Tick(price));
+            return iterator{ this, iterator::Segment::Window, overflow, tick }.Settle();
+        }
+        if (BeforeWindow(price))
+            return iterator{ this, iterator::Segment::Before, overflow }.Settle();
+        return iterator{ this, iterator::Segment::After, overflow };
+    }
+
+    static Level MakeLevel(std::int32_t price) {
+        Level level{};
+        level.price = price;
+        return level;
+    }
+
+    // Emptied window levels are recycled, keeping their queue storage
+    Level* Acquire(std::int32_t price) {
+        if (spare_.empty())
+            return &pool_.emplace_back(MakeLevel(price));
+        Level* level = spare_.back();
+        spare_.pop_back();
+        level->price = price;
+        return level;
+    }
+
+    void Release(Level* level) {
+        level->Clear();
+        spare_.push_back(level);
+    }
+
+    std::int64_t base_{0};
+    std::size_t windowLevels_{0};
+    Bitmap ticks_;
+    std::vector<Level*> slots_;
+    std::deque<Level> pool_;
+    std::vector<Level*> spare_;
+    Overflow overflow_;
+};
+
+// Cost of taking liquidity from a ladder up to a target size. quantity falls
+// short of the target when the ladder is not deep enough.
+struct FillEstimate {
+    std::uint64_t quantity{0};
+    std::int64_t notional{0};       // Sum of price * quantity over the fill
+    std::int32_t worstPrice{0};     // Last price touched
+    std::size_t levels{0};          // Levels touched, including a partly taken one
+
+    double Vwap() const { return quantity == 0 ? 0.0 : static_cast<double>(notional) / static_cast<double>(quantity); }
+};
+
+// Kernels over parallel arrays of level prices and quantities. Each has a scalar
+// version; on x86-64 the widest AVX2 or AVX-512 version the CPU supports is chosen
+// once at startup, so the binary runs on any x86-64 machine. Building with
+// ORDERBOOK_SCALAR_KERNELS leaves only the scalar versions.
+class DepthKernels {
+public:
+    // out[i] = quantities[0] + ... + quantities[i]
+    void (*prefixSum)(const std::uint32_t* quantities, std::size_t count, std::uint64_t* out);
+    // Total quantity of the levels priced within [low, high]
+    std::uint64_t (*sumWithin)(const std::int32_t* prices, const std::uint32_t* quantities, std::size_t count,
+                               std::int32_t low, std::int32_t high);
+    // Number of leading levels that can be taken whole while staying below target;
+    // their quantity and notional are added to quantity and notional
+    std::size_t (*takeWhole)(const std::int32_t* prices, const std::uint32_t* quantities, std::size_t count,
+                             std::uint64_t target, std::uint64_t& quantity, std::int64_t& notional);
+
+    static const DepthKernels& Get() {
+        static const DepthKernels kernels = Avx512().value_or(Avx2().value_or(Scalar()));
+        return kernels;
+    }
+
+    // Each set on its own, for comparing them; the vector ones are nullopt where
+    // the CPU or the build lacks them
+    static DepthKernels Scalar() { return DepthKernels{ PrefixSumScalar, SumWithinScalar, TakeWholeScalar }; }
+
+    static std::optional<DepthKernels> Avx2() {
+#ifdef ORDERBOOK_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return DepthKernels{ PrefixSumAvx2, SumWithinAvx2, TakeWholeAvx2 };
+#endif
+        return std::nullopt;
+    }
+
+    // Keeps the AVX2 prefix-sum and fill kernels, so it needs both extensions
+    static std::optional<DepthKernels> Avx512() {
+#ifdef ORDERBOOK_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2"))
+            return DepthKernels{ PrefixSumAvx2, SumWithinAvx512, TakeWholeAvx2 };
+#endif
+        return std::nullopt;
+    }
+
+private:
+    static void PrefixSumScalar(const std::uint32_t* quantities, std::size_t count, std::uint64_t* out) {
+        std::uint64_t running = 0;
+        for (std::size_t i = 0; i < count; ++i)
+            out[i] = running += quantities[i];
+    }
+
+    static std::uint64_t SumWithinScalar(const std::int32_t* prices, const std::uint32_t* quantities,
+                                         std::size_t count, std::int32_t low, std::int32_t high) {
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < count; ++i)
+            sum += prices[i] >= low && prices[i] <= high ? quantities[i] : 0;
+        return sum;
+    }
+
+    static std::size_t TakeWholeScalar(const std::int32_t* prices, const std::uint32_t* quantities, std::size_t count,
+                                       std::uint64_t target, std::uint64_t& quantity, std::int64_t& notional) {
+        std::size_t i = 0;
+        for (; i < count && quantity + quantities[i] < target; ++i) {
+            quantity += quantities[i];
+            notional += static_cast<std::int64_t>(prices[i]) * quantities[i];
+        }
+        return i;
+    }
+
+#ifdef ORDERBOOK_X86_KERNELS
+    // 32-bit lanes are widened by adding the even and odd halves of each 64-bit lane
+    __attribute__((target("avx2")))
+    static __m256i WidenAdd(__m256i total, __m256i values) {
+        const __m256i lowHalf = _mm256_set1_epi64x(0xFFFFFFFF);
+        return _mm256_add_epi64(total, _mm256_add_epi64(_mm256_and_si256(values, lowHalf),
+                                                        _mm256_srli_epi64(values, 32)));
+    }
+
+    __attribute__((target("avx2")))
+    static std::uint64_t HorizontalSum(__m256i values) {
+        __m128i pair = _mm_add_epi64(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+        return static_cast<std::uint64_t>(_mm_cvtsi128_si64(pair)) + static_cast<std::uint64_t>(_mm_extract_epi64(pair, 1));
+    }
+
+    // Four 64-bit sums per step: an in-register scan, then the carry from the previous step
+    __attribute__((target("avx2")))
+    static void PrefixSumAvx2(const std::uint32_t* quantities, std::size_t count, std::uint64_t* out) {
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i carry = zero;
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m256i x = _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities + i)));
+            x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x03));
+            x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x0F));
+            x = _mm256_add_epi64(x, carry);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), x);
+            carry = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+        std::uint64_t running = i == 0 ? 0 : out[i - 1];
+        for (; i < count; ++i)
+            out[i] = running += quantities[i];
+    }
+
+    __attribute__((target("avx2")))
+    static std::uint64_t SumWithinAvx2(const std::int32_t* prices, const std::uint32_t* quantities,
+                                       std::size_t count, std::int32_t low, std::int32_t high) {
+        const __m256i lowPrice = _mm256_set1_epi32(low);
+        const __m256i highPrice = _mm256_set1_epi32(high);
+        __m256i total = _mm256_setzero_si256();
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i));
+            __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(quantities + i));
+            __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(lowPrice, p), _mm256_cmpgt_epi32(p, highPrice));
+            total = WidenAdd(total, _mm256_andnot_si256(outside, q));
+        }
+        return HorizontalSum(total) + SumWithinScalar(prices + i, quantities + i, count - i, low, high);
+    }
+
+    // Blocks of eight levels are taken whole until one would reach the target.
+    // Prices are multiplied as unsigned; each negative price p was read as p + 2^32,
+    // so 2^32 times the quantity at negative prices is subtracted at the end.
+    __attribute__((target("avx2")))
+    static std::size_t TakeWholeAvx2(const std::int32_t* prices, const std::uint32_t* quantities, std::size_t count,
+                                     std::uint64_t target, std::uint64_t& quantity, std::int64_t& notional) {
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i products = zero, negative = zero;
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i));
+            __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(quantities + i));
+            std::uint64_t block = HorizontalSum(WidenAdd(zero, q));
+            if (quantity + block >= target)
+                break;
+            quantity += block;
+            products = _mm256_add_epi64(products, _mm256_mul_epu32(p, q));
+            products = _mm256_add_epi64(products, _mm256_mul_epu32(_mm256_srli_epi64(p, 32), _mm256_srli_epi64(q, 32)));
+            negative = WidenAdd(negative, _mm256_and_si256(q, _mm256_cmpgt_epi32(zero, p)));
+        }
+        notional += static_cast<std::int64_t>(HorizontalSum(products) - (HorizontalSum(negative) << 32));
+        return i + TakeWholeScalar(prices + i, quantities + i, count - i, target, quantity, notional);
+    }
+
+    // Sixteen levels per step, with the tail handled by a masked load
+    __attribute__((target("avx512f")))
+    static std::uint64_t SumWithinAvx512(const std::int32_t* prices, const std::uint32_t* quantities,
+                                         std::size_t count, std::int32_t low, std::int32_t high) {
+        const __m512i lowPrice = _mm512_set1_epi32(low);
+        const __m512i highPrice = _mm512_set1_epi32(high);
+        const __m512i lowHalf = _mm512_set1_epi64(0xFFFFFFFF);
+        __m512i total = _mm512_setzero_si512();
+        for (std::size_t i = 0; i < count; i += 16) {
+            __mmask16 lanes = count - i >= 16 ? __mmask16(0xFFFF) : static_cast<__mmask16>((1u << (count - i)) - 1);
+            __m512i p = _mm512_maskz_loadu_epi32(lanes, prices + i);
+            __mmask16 inside = _mm512_mask_cmpge_epi32_mask(lanes, p, lowPrice) & _mm512_cmple_epi32_mask(p, highPrice);
+            __m512i q = _mm512_maskz_loadu_epi32(inside, quantities + i);
+            total = _mm512_add_epi64(total, _mm512_add_epi64(_mm512_and_si512(q, lowHalf), _mm512_maskz_srli_epi64(0xFF, q, 32)));
+        }
+        alignas(64) std::uint64_t lanes[8];
+        _mm512_store_si512(lanes, total);
+        return std::accumulate(std::begin(lanes), std::end(lanes), std::uint64_t{0});
+    }
+#endif
+};
+
+// One side of the book flattened into parallel arrays, best level first, for
+// pre-trade liquidity queries. Refilling a ladder reuses its storage.
+class DepthLadder {
+public:
+    Side GetSide() const { return side_; }
+    std::size_t Size() const { return prices_.size(); }
+    const std::vector<std::int32_t>& GetPrices() const { return prices_; }
+    const std::vector<std::uint32_t>& GetQuantities() const { return quantities_; }
+
+    void Reset(Side side) {
+        side_ = side;
+        prices_.clear();
+        quantities_.clear();
+    }
+
+    void PushBack(std::int32_t price, std::uint32_t quantity) {
+        prices_.push_back(price);
+        quantities_.push_back(quantity);
+    }
+
+    // Quantity available through each level, best first
+    void GetCumulativeQuantities(std::vector<std::uint64_t>& cumulative) const {
+        cumulative.resize(Size());
+        DepthKernels::Get().prefixSum(quantities_.data(), Size(), cumulative.data());
+    }
+
+    // Quantity available at prices at or better than price
+    std::uint64_t GetQuantityThrough(std::int32_t price) const {
+        constexpr auto lowest = std::numeric_limits<std::int32_t>::min();
+        constexpr auto highest = std::numeric_limits<std::int32_t>::max();
+        return side_ == Side::Buy ? SumWithin(price, highest) : SumWithin(lowest, price);
+    }
+
+    // Quantity available within ticks of the best price
+    std::uint64_t GetQuantityWithinTicks(std::uint32_t ticks) const {
+        if (prices_.empty())
+            return 0;
+        std::int64_t best = prices_.front();
+        std::int64_t limit = side_ == Side::Buy ? best - ticks : best + ticks;
+        limit = std::clamp<std::int64_t>(limit, std::numeric_limits<std::int32_t>::min(), std::numeric_limits<std::int32_t>::max());
+        return side_ == Side::Buy ? SumWithin(static_cast<std::int32_t>(limit), prices_.front())
+                                  : SumWithin(prices_.front(), static_cast<std::int32_t>(limit));
+    }
+
+    // Sweep the ladder for quantity, as an aggressive order without a limit would
+    FillEstimate EstimateFill(std::uint64_t quantity) const {
+        FillEstimate fill;
+        if (quantity == 0 || prices_.empty())
+            return fill;
+        fill.levels = DepthKernels::Get().takeWhole(prices_.data(), quantities_.data(), Size(), quantity,
+                                                    fill.quantity, fill.notional);
+        if (fill.levels == Size()) {
+            fill.worstPrice = prices_.back();
+            return fill;
+        }
+        std::uint64_t last = quantity - fill.quantity;
+        fill.quantity += last;
+        fill.notional += static_cast<std::int64_t>(prices_[fill.levels]) * static_cast<std::int64_t>(last);
+        fill.worstPrice = prices_[fill.levels++];
+        return fill;
+    }
+
+private:
+    std::uint64_t SumWithin(std::int32_t low, std::int32_t high) const {
+        return DepthKernels::Get().sumWithin(prices_.data(), quantities_.data(), Size(), low, high);
+    }
+
+    Side side_{Side::Buy};
+    std::vector<std::int32_t> prices_;
+    std::vector<std::uint32_t> quantities_;
+};
+
+// OrderBook maintains and matches orders
+template <MatchingPolicy Policy = MatchingPolicy::Fifo>
+class OrderBook {
+private:
+    // Where a resting order sits; the order's own fields are kept in its level's queue
+    struct OrderEntry {
+        OrderQueue::Handle position;
+        Side side;
+        OrderLevel* level;        // Level addresses are stable, so the level can be reached without a lookup
+        // Intrusive list of the owner's resting orders
+        OrderEntry* ownerPrev{nullptr};
+        OrderEntry* ownerNext{nullptr};
+    };
+
+    // Cumulative quantity from the aggressive end of a side up to and including price
+    struct DepthPoint {
+        std::int32_t price;
+        std::uint64_t cumulative;
+    };
+
+    // Bids: descending order
+    SideBook<Side::Buy> bids_;
+    // Asks: ascending order
+    SideBook<Side::Sell> asks_;
+    // Lookup table for orders by ID.
+    std::unordered_map<std::uint64_t, OrderEntry> orders_;
+    // Head of each owner's intrusive order list; anonymous orders are not linked
+    std::unordered_map<std::uint32_t, OrderEntry*> ownerOrders_;
+    // Self-trade handling applied inside the matching loop
+    SelfTradePrevention selfTradePrevention_;
+    TradingPhase phase_{TradingPhase::Continuous};
+    // Published equilibrium while in the call phase
+    std::optional<AuctionUncross> indicative_;
+    std::uint64_t nextSequence_{0};
+    OrderBookStats stats_;
+    // Pending GoodTillDate and GoodForDay expiries
+    TimerWheel expiries_;
+    Timestamp endOfDay_{NoExpiry};
+    // An incoming order while it matches, before anything of it rests
+    OrderLevel incoming_{ 0, 0, OrderQueue{} };
+
+    // Check if an order can match based on its price
+    bool CanMatch(Side side, std::int32_t price) const {
+        if (side == Side::Buy)
+            return !asks_.empty() && price >= asks_.begin()->price;
+        return !bids_.empty() && price <= bids_.begin()->price;
+    }
+
+    // Best level of a side that is not empty
+    OrderLevel& BestLevel(Side side) {
+        return side == Side::Buy ? *bids_.begin() : *asks_.begin();
+    }
+
+    void EraseLevel(Side side, std::int32_t price) {
+        if (side == Side::Buy)
+            bids_.erase(price);
+        else
+            asks_.erase(price);
+    }
+
+    void LinkOwner(OrderEntry& entry) {
+        std::uint32_t ownerId = entry.level->orders.GetOwnerId(entry.position);
+        if (ownerId == AnonymousOwner)
+            return;
+        auto& head = ownerOrders_[ownerId];
+        entry.ownerNext = head;
+        if (head)
+            head->ownerPrev = &entry;
+        head = &entry;
+    }
+
+    void UnlinkOwner(OrderEntry& entry) {
+        std::uint32_t ownerId = entry.level->orders.GetOwnerId(entry.position);
+        if (ownerId == AnonymousOwner)
+            return;
+        if (entry.ownerPrev)
+            entry.ownerPrev->ownerNext = entry.ownerNext;
+        else if (entry.ownerNext)
+            ownerOrders_[ownerId] = entry.ownerNext;
+        else
+            ownerOrders_.erase(ownerId);
+        if (entry.ownerNext)
+            entry.ownerNext->ownerPrev = entry.ownerPrev;
+    }
+
+    // Drop an order from the lookup table and its owner's list, leaving its level alone
+    void EraseEntry(std::uint64_t orderId) {
+        auto entry = orders_.find(orderId);
+        UnlinkOwner(entry->second);
+        orders_.erase(entry);
+    }
+
+    // Unlink an order from its level and the lookup table. Emptied levels are kept
+    // so the matching loop can keep using them; the caller erases them.
+    void RemoveOrder(typename std::unordered_map<std::uint64_t, OrderEntry>::iterator entry) {
+        OrderEntry& removed = entry->second;
+        removed.level->quantity -= removed.level->orders.GetQuantity(removed.position);
+        removed.level->orders.Erase(removed.position);
+        UnlinkOwner(removed);
+        orders_.erase(entry);
+    }
+
+    // Squeeze tombstones out of a level's queue once they dominate it. Only called
+    // between scans, since it moves orders to new positions.
+    void CompactLevel(OrderLevel& level) {
+        if (level.orders.NeedsCompaction())
+            level.orders.Compact([this](std::uint64_t orderId, OrderQueue::Handle position) {
+                orders_.find(orderId)->second.position = position;
+            });
+    }
+
+    // Remove the order at a position in a level. The level may be incoming_, whose
+    // order has no lookup entry yet.
+    void RemoveOrder(OrderLevel& level, OrderQueue::Handle position) {
+        auto entry = orders_.find(level.orders.GetOrderId(position));
+        if (entry != orders_.end()) {
+            UnlinkOwner(entry->second);
+            orders_.erase(entry);
+        }
+        level.quantity -= level.orders.GetQuantity(position);
+        level.orders.Erase(position);
+    }
+
+    // Resolve a crossing between two orders of the same owner, the aggressor being
+    // the newer one. Returns true if the orders must not trade, in which case one or
+    // both have been reduced or removed.
+    bool PreventSelfTrade(OrderLevel& aggressorLevel, OrderQueue::Handle aggressor,
+                          OrderLevel& restingLevel, OrderQueue::Handle resting) {
+        auto& aggressorOrders = aggressorLevel.orders;
+        auto& restingOrders = restingLevel.orders;
+        if (selfTradePrevention_ == SelfTradePrevention::None ||
+            aggressorOrders.GetOwnerId(aggressor) == AnonymousOwner)
+            return false;
+
+        switch (selfTradePrevention_) {
+            case SelfTradePrevention::CancelNewest:
+                RemoveOrder(aggressorLevel, aggressor);
+                break;
+            case SelfTradePrevention::CancelOldest:
+                RemoveOrder(restingLevel, resting);
+                break;
+            case SelfTradePrevention::CancelBoth:
+                RemoveOrder(aggressorLevel, aggressor);
+                RemoveOrder(restingLevel, resting);
+                break;
+            case SelfTradePrevention::Decrement: {
+                std::uint32_t quantity = std::min(aggressorOrders.GetQuantity(aggressor),
+                                                  restingOrders.GetQuantity(resting));
+                stats_.verificationFailures += !aggressorOrders.Fill(aggressor, quantity);
+                stats_.verificationFailures += !restingOrders.Fill(resting, quantity);
+                aggressorLevel.quantity -= quantity;
+                restingLevel.quantity -= quantity;
+                if (aggressorOrders.GetQuantity(aggressor) == 0)
+                    RemoveOrder(aggressorLevel, aggressor);
+                if (restingOrders.GetQuantity(resting) == 0)
+                    RemoveOrder(restingLevel, resting);
+                break;
+            }
+            case SelfTradePrevention::None:
+                break;
+        }
+        return true;
+    }
+
+    // Fill an aggressor against one resting order and record the trade
+    void Execute(Side aggressorSide, OrderLevel& aggressorLevel, OrderQueue::Handle aggressor,
+                 OrderLevel& restingLevel, OrderQueue::Handle resting,
+                 std::uint32_t quantity, std::vector<Trade>& trades) {
+        stats_.verificationFailures += !aggressorLevel.orders.Fill(aggressor, quantity);
+        stats_.verificationFailures += !restingLevel.orders.Fill(resting, quantity);
+        aggressorLevel.quantity -= quantity;
+        restingLevel.quantity -= quantity;
+
+        TradeInfo aggressorTrade{ aggressorLevel.orders.GetOrderId(aggressor), aggressorLevel.price, quantity,
+                                  aggressorLevel.orders.GetOwnerId(aggressor) };
+        TradeInfo restingTrade{ restingLevel.orders.GetOrderId(resting), restingLevel.price, quantity,
+                                restingLevel.orders.GetOwnerId(resting) };
+        if (aggressorSide == Side::Buy)
+            trades.push_back(Trade{ aggressorTrade, restingTrade, restingLevel.price });
+        else
+            trades.push_back(Trade{ restingTrade, aggressorTrade, restingLevel.price });
+    }
+
+    // Match the aggressor against a resting level in proportion to each order's size.
+    // Allocations use cumulative rounding against the level's cached total, so they
+    // sum exactly to the matched quantity in a single pass over the level.
+    void MatchLevelProRata(Side aggressorSide, OrderLevel& aggressorLevel, OrderQueue::Handle aggressor,
+                           OrderLevel& restingLevel, std::vector<Trade>& trades) {
+        auto& restingOrders = restingLevel.orders;
+
+        // Time priority for the top order, if the policy grants it
+        if constexpr (Policy == MatchingPolicy::FifoProRata) {
+            OrderQueue::Handle top = restingOrders.Front();
+            Execute(aggressorSide, aggressorLevel, aggressor, restingLevel, top,
+                    std::min(aggressorLevel.orders.GetQuantity(aggressor), restingOrders.GetQuantity(top)), trades);
+            if (restingOrders.GetQuantity(top) == 0)
+                RemoveOrder(restingLevel, top);
+        }
+
+        const std::uint64_t total = restingLevel.quantity;
+        const std::uint64_t matched = std::min<std::uint64_t>(aggressorLevel.orders.GetQuantity(aggressor), total);
+        std::uint64_t cumulative = 0;
+        std::uint64_t allocated = 0;
+        for (OrderQueue::Handle resting = restingOrders.Front();
+             resting < restingOrders.End() && allocated < matched; ++resting) {
+            if (!restingOrders.IsLive(resting))
+                continue;
+            cumulative += restingOrders.GetQuantity(resting);
+            std::uint64_t target = cumulative * matched / total;
+            auto quantity = static_cast<std::uint32_t>(target - allocated);
+            allocated = target;
+            if (quantity == 0)
+                continue;
+
+            Execute(aggressorSide, aggressorLevel, aggressor, restingLevel, resting, quantity, trades);
+            if (restingOrders.GetQuantity(resting) == 0)
+                RemoveOrder(restingLevel, resting);
+        }
+    }
+
+    // Apply self-trade prevention to every order of the aggressor's owner at the
+    // resting level before it is allocated pro-rata.
+    void PreventSelfTradesAtLevel(OrderLevel& aggressorLevel, OrderQueue::Handle aggressor,
+                                  OrderLevel& restingLevel) {
+        auto& aggressorOrders = aggressorLevel.orders;
+        std::uint32_t ownerId = aggressorOrders.GetOwnerId(aggressor);
+        if (selfTradePrevention_ == SelfTradePrevention::None || ownerId == AnonymousOwner)
+            return;
+
+        auto& restingOrders = restingLevel.orders;
+        for (OrderQueue::Handle resting = restingOrders.Front();
+             resting < restingOrders.End() && aggressorOrders.IsLive(aggressor); ++resting) {
+            if (restingOrders.IsLive(resting) && restingOrders.GetOwnerId(resting) == ownerId)
+                PreventSelfTrade(aggressorLevel, aggressor, restingLevel, resting);
+        }
+    }
+
+    // Find the auction equilibrium with one ascending scan over the crossed region
+    // of both sides: executable volume is maximised, then imbalance minimised, and
+    // remaining ties go to the higher price under buy pressure, else the lower.
+    std::optional<AuctionUncross> ComputeUncross() const {
+        if (bids_.empty() || asks_.empty())
+            return std::nullopt;
+        const std::int32_t bestBid = bids_.begin()->price;
+        const std::int32_t bestAsk = asks_.begin()->price;
+        if (bestBid < bestAsk)
+            return std::nullopt;
+
+        // Demand at or above each bid price, supply at or below each ask price, both ascending
+        std::vector<DepthPoint> demand, supply;
+        std::uint64_t cumulative = 0;
+        for (auto it = bids_.begin(); it != bids_.end() && it->price >= bestAsk; ++it)
+            demand.push_back(DepthPoint{ it->price, cumulative += it->quantity });
+        std::reverse(demand.begin(), demand.end());
+        cumulative = 0;
+        for (auto it = asks_.begin(); it != asks_.end() && it->price <= bestBid; ++it)
+            supply.push_back(DepthPoint{ it->price, cumulative += it->quantity });
+
+        std::optional<AuctionUncross> best;
+        std::size_t b = 0, a = 0;
+        while (b < demand.size() || a < supply.size()) {
+            std::int32_t price = b == demand.size() ? supply[a].price
+                               : a == supply.size() ? demand[b].price
+                               : std::min(demand[b].price, supply[a].price);
+            while (a < supply.size() && supply[a].price <= price)
+                ++a;
+            std::uint64_t buyVolume = b < demand.size() ? demand[b].cumulative : 0;
+            std::uint64_t sellVolume = a > 0 ? supply[a - 1].cumulative : 0;
+            if (b < demand.size() && demand[b].price == price)
+                ++b;
+
+            std::uint64_t volume = std::min(buyVolume, sellVolume);
+            std::int64_t imbalance = static_cast<std::int64_t>(buyVolume) - static_cast<std::int64_t>(sellVolume);
+            if (volume == 0)
+                continue;
+            if (!best || volume > best->volume ||
+                (volume == best->volume && (std::abs(imbalance) < std::abs(best->imbalance) ||
+                                            (std::abs(imbalance) == std::abs(best->imbalance) && imbalance > 0))))
+                best = AuctionUncross{ price, volume, imbalance };
+        }
+        return best;
+    }
+
+    // Trade up to volume at price in one pass from the best levels down, working
+    // queues in time priority
+    void UncrossAt(std::int32_t price, std::uint64_t volume, std::vector<Trade>& trades) {
+        std::uint64_t remaining = volume;
+        while (remaining > 0 && !bids_.empty() && !asks_.empty()) {
+            auto bestBid = bids_.begin();
+            auto bestAsk = asks_.begin();
+            if (bestBid->price < price || bestAsk->price > price)
+                break;
+
+            auto& bidLevel = *bestBid;
+            auto& askLevel = *bestAsk;
+            auto& bidOrders = bidLevel.orders;
+            auto& askOrders = askLevel.orders;
+            OrderQueue::Handle bid = bidOrders.Front();
+            OrderQueue::Handle ask = askOrders.Front();
+
+            if (bidOrders.GetOwnerId(bid) == askOrders.GetOwnerId(ask)) {
+                bool bidIsNewer = bidOrders.GetDetails(bid).sequence > askOrders.GetDetails(ask).sequence;
+                if (bidIsNewer ? PreventSelfTrade(bidLevel, bid, askLevel, ask)
+                               : PreventSelfTrade(askLevel, ask, bidLevel, bid)) {
+                    if (bidOrders.Empty())
+                        bids_.erase(bestBid);
+                    if (askOrders.Empty())
+                        asks_.erase(bestAsk);
+                    continue;
+                }
+            }
+
+            auto quantity = static_cast<std::uint32_t>(std::min<std::uint64_t>(
+                    remaining, std::min(bidOrders.GetQuantity(bid), askOrders.GetQuantity(ask))));
+            stats_.verificationFailures += !bidOrders.Fill(bid, quantity);
+            stats_.verificationFailures += !askOrders.Fill(ask, quantity);
+            bidLevel.quantity -= quantity;
+            askLevel.quantity -= quantity;
+            remaining -= quantity;
+            trades.push_back(Trade{
+                    TradeInfo{ bidOrders.GetOrderId(bid), price, quantity, bidOrders.GetOwnerId(bid) },
+                    TradeInfo{ askOrders.GetOrderId(ask), price, quantity, askOrders.GetOwnerId(ask) },
+                    price
+            });
+
+            if (bidOrders.GetQuantity(bid) == 0)
+                RemoveOrder(bidLevel, bid);
+            if (askOrders.GetQuantity(ask) == 0)
+                RemoveOrder(askLevel, ask);
+            if (bidOrders.Empty())
+                bids_.erase(bestBid);
+            else
+                CompactLevel(bidLevel);
+            if (askOrders.Empty())
+                asks_.erase(bestAsk);
+            else
+                CompactLevel(askLevel);
+        }
+    }
+
+    // Drop every order on a run of levels, then erase the levels in one go
+    template <typename Levels>
+    void CancelLevels(Levels& levels, typename Levels::iterator first, typename Levels::iterator last,
+                      std::vector<std::uint64_t>& cancelled) {
+        for (auto it = first; it != last; ++it) {
+            const auto& orders = it->orders;
+            for (OrderQueue::Handle handle = orders.Front(); handle < orders.End(); ++handle) {
+                if (!orders.IsLive(handle))
+                    continue;
+                cancelled.push_back(orders.GetOrderId(handle));
+                EraseEntry(orders.GetOrderId(handle));
+            }
+        }
+        levels.erase(first, last);
+    }
+
+    // After a batch of removals, compact the levels that kept orders and erase the
+    // ones that emptied. A level may appear more than once.
+    void TidyLevels(const std::vector<std::pair<Side, OrderLevel*>>& touched) {
+        std::vector<std::pair<Side, std::int32_t>> emptied;
+        for (const auto& [side, level] : touched) {
+            if (!level->orders.Empty())
+                CompactLevel(*level);
+            else
+                emptied.emplace_back(side, level->price);
+        }
+        for (const auto& [side, price] : emptied)
+            EraseLevel(side, price);
+    }
+
+    void RefreshIndicative() {
+        if (phase_ == TradingPhase::Auction)
+            indicative_ = ComputeUncross();
+    }
+
+    // Refresh the published equilibrium if an order at this price could change it
+    void UpdateIndicative(Side side, std::int32_t price) {
+        if (phase_ == TradingPhase::Auction && CanMatch(side, price))
+            indicative_ = ComputeUncross();
+    }
+
+    // Match an incoming order against the opposite side, appending trades. The order
+    // is held in its own level outside the book, so nothing has to be cleaned up if it
+    // is filled or may not rest.
+    void MatchOrders(Side aggressorSide, OrderLevel& incoming, std::vector<Trade>& trades) {
+        const Side restingSide = aggressorSide == Side::Buy ? Side::Sell : Side::Buy;
+        auto& incomingOrders = incoming.orders;
+        const OrderQueue::Handle aggressor = incomingOrders.Front();
+
+        while (incomingOrders.IsLive(aggressor) && CanMatch(aggressorSide, incoming.price)) {
+            auto& restingLevel = BestLevel(restingSide);
+            auto& restingOrders = restingLevel.orders;
+
+            if constexpr (Policy == MatchingPolicy::Fifo) {
+                while (incomingOrders.IsLive(aggressor) && !restingOrders.Empty()) {
+                    OrderQueue::Handle resting = restingOrders.Front();
+
+                    // Single owner comparison per fill
+                    if (incomingOrders.GetOwnerId(aggressor) == restingOrders.GetOwnerId(resting) &&
+                        PreventSelfTrade(incoming, aggressor, restingLevel, resting))
+                        continue;
+
+                    Execute(aggressorSide, incoming, aggressor, restingLevel, resting,
+                            std::min(incomingOrders.GetQuantity(aggressor), restingOrders.GetQuantity(resting)), trades);
+
+                    if (incomingOrders.GetQuantity(aggressor) == 0)
+                        incomingOrders.Erase(aggressor);
+                    if (restingOrders.GetQuantity(resting) == 0) {
+                        EraseEntry(restingOrders.GetOrderId(resting));
+                        restingOrders.Erase(resting);
+                    }
+                }
+            } else {
+                PreventSelfTradesAtLevel(incoming, aggressor, restingLevel);
+                if (incomingOrders.IsLive(aggressor) && !restingOrders.Empty()) {
+                    MatchLevelProRata(aggressorSide, incoming, aggressor, restingLevel, trades);
+                    if (incomingOrders.GetQuantity(aggressor) == 0)
+                        incomingOrders.Erase(aggressor);
+                }
+            }
+
+            // The level is erased only here, after its queue is no longer being walked;
+            // nothing refers to it once the next iteration starts
+            if (restingOrders.Empty())
+                EraseLevel(restingSide, restingLevel.price);
+            else
+                CompactLevel(restingLevel);
+        }
+    }
+
+    OrderStatus Reject(OrderStatus status) {
+        ++stats_.rejected;
+        return status;
+    }
+
+    // Match a validated order, then rest what is left of it. Outside the call phase a
+    // crossing order is matched from incoming_ first, so filled orders and FillAndKill
+    // residuals never enter the book.
+    OrderStatus InsertOrder(OrderType type, std::uint64_t orderId, Side side, std::int32_t price, std::uint32_t initialQuantity,
+                            std::uint32_t remaining, std::uint32_t ownerId, Timestamp orderExpiry,
+                            std::vector<Trade>& trades) {
+        if (type == OrderType::FillAndKill && (phase_ == TradingPhase::Auction || !CanMatch(side, price)))
+            return Reject(OrderStatus::WouldNotMatch);
+
+        Timestamp expiry = NoExpiry;
+        if (type == OrderType::GoodTillDate)
+            expiry = orderExpiry;
+        else if (type == OrderType::GoodForDay)
+            expiry = endOfDay_;
+        if (expiry <= expiries_.Now())
+            return Reject(OrderStatus::Expired);
+
+        std::uint64_t sequence = nextSequence_++;
+        OrderDetails details{ type, initialQuantity, orderExpiry, sequence };
+
+        // During the call phase orders only accumulate
+        if (phase_ == TradingPhase::Continuous && CanMatch(side, price)) {
+            incoming_.price = price;
+            incoming_.quantity = remaining;
+            incoming_.orders.Clear();
+            incoming_.orders.PushBack(orderId, remaining, ownerId, details);
+            MatchOrders(side, incoming_, trades);
+            if (incoming_.orders.Empty() || type == OrderType::FillAndKill)
+                return OrderStatus::Accepted;
+            remaining = incoming_.orders.GetQuantity(incoming_.orders.Front());
+        }
+
+        auto& level = side == Side::Buy ? bids_.Emplace(price) : asks_.Emplace(price);
+        auto position = level.orders.PushBack(orderId, remaining, ownerId, details);
+        level.quantity += remaining;
+
+        auto [entry, _] = orders_.insert({ orderId, OrderEntry{ position, side, &level } });
+        LinkOwner(entry->second);
+        if (expiry != NoExpiry)
+            expiries_.Schedule({ orderId, sequence, expiry });
+
+        if (phase_ == TradingPhase::Auction)
+            UpdateIndicative(side, price);
+        return OrderStatus::Accepted;
+    }
+
+    // Validate, then match and rest
+    OrderStatus SubmitOrder(OrderType type, std::uint64_t orderId, Side side, std::int32_t price,
+                            std::uint32_t initialQuantity, std::uint32_t remaining, std::uint32_t ownerId,
+                            Timestamp expiry, std::vector<Trade>& trades) {
+        if (remaining == 0)
+            return Reject(OrderStatus::InvalidQuantity);
+        if (orders_.contains(orderId))
+            return Reject(OrderStatus::DuplicateId);
+
+        return InsertOrder(type, orderId, side, price, initialQuantity, remaining, ownerId, expiry, trades);
+    }
+
+public:
+    explicit OrderBook(SelfTradePrevention selfTradePrevention = SelfTradePrevention::None)
+            : selfTradePrevention_{selfTradePrevention} {}
+
+    // Add a new order and try to match, appending any trades
+    OrderStatus AddOrder(std::shared_ptr<Order> order, std::vector<Trade>& trades) {
+        return SubmitOrder(order->GetOrderType(), order->GetOrderId(), order->GetSide(), order->GetPrice(),
+                           order->GetInitialQuantity(), order->GetRemainingQuantity(), order->GetOwnerId(),
+                           order->GetExpiry(), trades);
+    }
+
+    // Add a new order given by its fields, for callers such as wire decoders that
+    // have no Order to hand over
+    OrderStatus AddOrder(OrderType type, std::uint64_t orderId, Side side, std::int32_t price, std::uint32_t quantity,
+                         std::uint32_t ownerId, Timestamp expiry, std::vector<Trade>& trades) {
+        return SubmitOrder(type, orderId, side, price, quantity, quantity, ownerId, expiry, trades);
+    }
+
+    std::vector<Trade> AddOrder(std::shared_ptr<Order> order) {
+        std::vector<Trade> trades;
+        AddOrder(std::move(order), trades);
+        return trades;
+    }
+
+    // Cancel an order by its ID
+    OrderStatus CancelOrder(std::uint64_t orderId) {
+        auto entry = orders_.find(orderId);
+        if (entry == orders_.end())
+            return Reject(OrderStatus::UnknownId);
+
+        Side side = entry->second.side;
+        OrderLevel& level = *entry->second.level;
+        std::int32_t price = level.price;
+        RemoveOrder(entry);
+
+        if (level.orders.Empty())
+            EraseLevel(side, price);
+        else
+            CompactLevel(level);
+        UpdateIndicative(side, price);
+        return OrderStatus::Accepted;
+    }
+
+    // Cancel every resting order; returns the ids cancelled
+    std::vector<std::uint64_t> CancelAllOrders() {
+        std::vector<std::uint64_t> cancelled;
+        cancelled.reserve(orders_.size());
+        for (const auto& [orderId, _] : orders_)
+            cancelled.push_back(orderId);
+        bids_.clear();
+        asks_.clear();
+        orders_.clear();
+        ownerOrders_.clear();
+        indicative_.reset();
+        return cancelled;
+    }
+
+    // Cancel every resting order on one side
+    std::vector<std::uint64_t> CancelOrders(Side side) {
+        std::vector<std::uint64_t> cancelled;
+        if (side == Side::Buy)
+            CancelLevels(bids_, bids_.begin(), bids_.end(), cancelled);
+        else
+            CancelLevels(asks_, asks_.begin(), asks_.end(), cancelled);
+        RefreshIndicative();
+        return cancelled;
+    }
+
+    // Cancel every resting order on one side priced within [minPrice, maxPrice]
+    std::vector<std::uint64_t> CancelOrders(Side side, std::int32_t minPrice, std::int32_t maxPrice) {
+        std::vector<std::uint64_t> cancelled;
+        if (minPrice > maxPrice)
+            return cancelled;
+        if (side == Side::Buy) {
+            auto [first, last] = bids_.Range(minPrice, maxPrice);
+            CancelLevels(bids_, first, last, cancelled);
+        } else {
+            auto [first, last] = asks_.Range(minPrice, maxPrice);
+            CancelLevels(asks_, first, last, cancelled);
+        }
+        RefreshIndicative();
+        return cancelled;
+    }
+
+    // Cancel every resting order of an owner, e.g. when its session disconnects.
+    // Walks the owner's own list, so the cost is independent of book size.
+    std::vector<std::uint64_t> CancelOwnerOrders(std::uint32_t ownerId) {
+        std::vector<std::uint64_t> cancelled;
+        auto head = ownerOrders_.find(ownerId);
+        if (ownerId == AnonymousOwner || head == ownerOrders_.end())
+            return cancelled;
+
+        std::vector<std::pair<Side, OrderLevel*>> touched;
+        for (OrderEntry* entry = head->second; entry != nullptr;) {
+            OrderEntry* next = entry->ownerNext;
+            OrderLevel& level = *entry->level;
+            level.quantity -= level.orders.GetQuantity(entry->position);
+            level.orders.Erase(entry->position);
+            touched.emplace_back(entry->side, &level);
+            cancelled.push_back(level.orders.GetOrderId(entry->position));
+            orders_.erase(cancelled.back());
+            entry = next;
+        }
+        ownerOrders_.erase(ownerId);
+        TidyLevels(touched);
+        RefreshIndicative();
+        return cancelled;
+    }
+
+    // Modify an existing order, appending any trades. It loses time priority and
+    // keeps its type, owner and expiry.
+    OrderStatus MatchOrder(std::uint64_t orderId, Side side, std::int32_t price, std::uint32_t quantity,
+                           std::vector<Trade>& trades) {
+        auto entry = orders_.find(orderId);
+        if (entry == orders_.end())
+            return Reject(OrderStatus::UnknownId);
+        if (quantity == 0)
+            return Reject(OrderStatus::InvalidQuantity);
+
+        const auto& orders = entry->second.level->orders;
+        OrderType type = orders.GetDetails(entry->second.position).type;
+        std::uint32_t ownerId = orders.GetOwnerId(entry->second.position);
+        Timestamp expiry = orders.GetDetails(entry->second.position).expiry;
+        CancelOrder(orderId);
+        return AddOrder(type, orderId, side, price, quantity, ownerId, expiry, trades);
+    }
+
+    OrderStatus MatchOrder(OrderModify order, std::vector<Trade>& trades) {
+        return MatchOrder(order.GetOrderId(), order.GetSide(), order.GetPrice(), order.GetQuantity(), trades);
+    }
+
+    std::vector<Trade> MatchOrder(OrderModify order) {
+        std::vector<Trade> trades;
+        MatchOrder(order, trades);
+        return trades;
+    }
+
+    std::size_t Size() const { return orders_.size(); }
+
+    // Owner of a resting order
+    std::optional<std::uint32_t> GetOwnerId(std::uint64_t orderId) const {
+        auto entry = orders_.find(orderId);
+        if (entry == orders_.end())
+            return std::nullopt;
+        return entry->second.level->orders.GetOwnerId(entry->second.position);
+    }
+
+    const OrderBookStats& GetStats() const { return stats_; }
+
+    TradingPhase GetPhase() const { return phase_; }
+
+    // End of the trading day; applies to GoodForDay orders added from now on
+    void SetEndOfDay(Timestamp endOfDay) { endOfDay_ = endOfDay; }
+
+    // Advance book time and remove every GoodTillDate/GoodForDay order that has
+    // expired, as one sweep: orders are unlinked through their stored level and
+    // position, and levels left empty are erased once at the end.
+    std::vector<std::uint64_t> ExpireOrders(Timestamp now) {
+        std::vector<TimerWheel::Timer> due;
+        expiries_.Advance(now, due);
+
+        std::vector<std::uint64_t> expired;
+        expired.reserve(due.size());
+        std::vector<std::pair<Side, OrderLevel*>> touched;
+        for (const auto& timer : due) {
+            auto entry = orders_.find(timer.id);
+            if (entry == orders_.end())
+                continue;
+            const OrderEntry& resting = entry->second;
+            if (resting.level->orders.GetDetails(resting.position).sequence != timer.tag)
+                continue;
+
+            touched.emplace_back(resting.side, resting.level);
+            RemoveOrder(entry);
+            expired.push_back(timer.id);
+        }
+        TidyLevels(touched);
+        if (phase_ == TradingPhase::Auction && !expired.empty())
+            indicative_ = ComputeUncross();
+        return expired;
+    }
+
+    // Enter the call phase: orders rest without matching until Uncross
+    void StartAuction() {
+        phase_ = TradingPhase::Auction;
+        indicative_ = ComputeUncross();
+    }
+
+    // Equilibrium price and volume the auction would uncross at right now
+    std::optional<AuctionUncross> GetIndicativeUncross() const { return indicative_; }
+
+    // Execute the auction at its equilibrium price, then return to continuous
+    // matching. Self-trade prevention can remove liquidity the equilibrium counted
+    // on and leave the book crossed; as continuous matching only matches incoming
+    // orders, the uncross then repeats at the new equilibrium.
+    std::vector<Trade> Uncross() {
+        std::vector<Trade> trades;
+        phase_ = TradingPhase::Continuous;
+        indicative_.reset();
+        while (auto uncross = ComputeUncross())
+            UncrossAt(uncross->price, uncross->volume, trades);
+        return trades;
+    }
+
+    // Flatten one side into ladder for cumulative-liquidity queries
+    void GetLadder(Side side, DepthLadder& ladder) const {
+        ladder.Reset(side);
+        if (side == Side::Buy) {
+            for (const auto& level : bids_)
+                ladder.PushBack(level.price, level.quantity);
+        } else {
+            for (const auto& level : asks_)
+                ladder.PushBack(level.price, level.quantity);
+        }
+    }
+
+    DepthLadder GetLadder(Side side) const {
+        DepthLadder ladder;
+        GetLadder(side, ladder);
+        return ladder;
+    }
+
+    // Number of price levels resting on one side
+    std::size_t GetLevelCount(Side side) const { return side == Side::Buy ? bids_.size() : asks_.size(); }
+
+    // Write one side's levels, best first, into a caller-provided buffer such as
+    // arena memory. Stops when the buffer is full; returns the number written.
+    std::size_t GetLevelInfos(Side side, std::span<LevelInfo> levels) const {
+        std::size_t written = 0;
+        auto write = [&](const auto& book) {
+            for (auto it = book.begin(); it != book.end() && written < levels.size(); ++it)
+                levels[written++] = LevelInfo{ it->price, it->quantity };
+        };
+        if (side == Side::Buy)
+            write(bids_);
+        else
+            write(asks_);
+        return written;
+    }
+
+    // Refill a snapshot in place; allocates only when the book is deeper than any
+    // snapshot taken into it before
+    void GetOrderInfos(OrderbookLevelInfos& infos) const {
+        infos.Reset(bids_.size(), asks_.size());
+        for (const auto& level : bids_)
+            infos.PushBack(Side::Buy, LevelInfo{ level.price, level.quantity });
+        for (const auto& level : asks_)
+            infos.PushBack(Side::Sell, LevelInfo{ level.price, level.quantity });
+    }
+
+    // Get aggregated order levels for bids and asks
+    OrderbookLevelInfos GetOrderInfos() const {
+        OrderbookLevelInfos infos;
+        GetOrderInfos(infos);
+        return infos;
+    }
+};
+
+// Top Depth levels of both sides, published by the matcher under a seqlock. The
+// writer never waits; a reader copies the levels and retries if a publish ran
+// meanwhile. Levels are stored as relaxed atomic words so the racing copy is
+// well defined. Assumes a single publishing thread.
+template <std::size_t Depth>
+class PublishedLevels {
+public:
+    struct View {
+        std::uint64_t version{0};       // Publishes so far; unchanged means nothing new
+        std::size_t bidCount{0};
+        std::size_t askCount{0};
+        std::array<LevelInfo, Depth> bids{};
+        std::array<LevelInfo, Depth> asks{};
+    };
+
+    // Call after each batch of book operations
+    template <typename Book>
+    void Publish(const Book& book) {
+        std::array<LevelInfo, Depth> bids, asks;
+        std::size_t bidCount = book.GetLevelInfos(Side::Buy, bids);
+        std::size_t askCount = book.GetLevelInfos(Side::Sell, asks);
+
+        std::uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        counts_[0].store(bidCount, std::memory_order_relaxed);
+        counts_[1].store(askCount, std::memory_order_relaxed);
+        for (std::size_t i = 0; i < bidCount; ++i)
+            bids_[i].store(Pack(bids[i]), std::memory_order_relaxed);
+        for (std::size_t i = 0; i < askCount; ++i)
+            asks_[i].store(Pack(asks[i]), std::memory_order_relaxed);
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Copy a consistent view; safe from any number of threads
+    void Read(View& view) const {
+        for (;;) {
+            std::uint64_t before = sequence_.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+            view.bidCount = std::min<std::size_t>(counts_[0].load(std::memory_order_relaxed), Depth);
+            view.askCount = std::min<std::size_t>(counts_[1].load(std::memory_order_relaxed), Depth);
+            for (std::size_t i = 0; i < view.bidCount; ++i)
+                view.bids[i] = Unpack(bids_[i].load(std::memory_order_relaxed));
+            for (std::size_t i = 0; i < view.askCount; ++i)
+                view.asks[i] = Unpack(asks_[i].load(std::memory_order_relaxed));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before) {
+                view.version = before / 2;
+                return;
+            }
+        }
+    }
+
+    View Read() const {
+        View view;
+        Read(view);
+        return view;
+    }
+
+private:
+    static std::uint64_t Pack(LevelInfo level) {
+        return static_cast<std::uint64_t>(static_cast<std::uint32_t>(level.price)) << 32 | level.quantity;
+    }
+
+    static LevelInfo Unpack(std::uint64_t word) {
+        return LevelInfo{ static_cast<std::int32_t>(static_cast<std::uint32_t>(word >> 32)),
+                          static_cast<std::uint32_t>(word) };
+    }
+
+    alignas(64) std::atomic<std::uint64_t> sequence_{0};
+    std::array<std::atomic<std::uint64_t>, 2> counts_{};
+    std::array<std::atomic<std::uint64_t>, Depth> bids_{};
+    std::array<std::atomic<std::uint64_t>, Depth> asks_{};
+};
+
+// Full-depth snapshots published RCU-style: each publish swaps in an immutable
+// OrderbookLevelInfos, and readers keep whichever one they loaded for as long as
+// they like. The snapshot the previous publish replaced is refilled in place once
+// no reader still holds it, so a steady publisher stops allocating.
+class PublishedDepth {
+public:
+    template <typename Book>
+    void Publish(const Book& book) {
+        std::shared_ptr<OrderbookLevelInfos> next = std::move(spare_);
+        if (!next || next.use_count() != 1)
+            next = std::make_shared<OrderbookLevelInfos>();
+        // use_count() is a relaxed load: order the refill after the last reader's
+        // release of the snapshot, so its final reads happen before our writes
+        std::atomic_thread_fence(std::memory_order_acquire);
+        book.GetOrderInfos(*next);
+        spare_ = std::const_pointer_cast<OrderbookLevelInfos>(
+                current_.exchange(std::move(next), std::memory_order_acq_rel));
+    }
+
+    // Latest snapshot, or null before the first publish; safe from any thread
+    std::shared_ptr<const OrderbookLevelInfos> Read() const { return current_.load(std::memory_order_acquire); }
+
+private:
+    std::atomic<std::shared_ptr<const OrderbookLevelInfos>> current_;
+    std::shared_ptr<OrderbookLevelInfos> spare_;    // Only touched by the publisher
+};
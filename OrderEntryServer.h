@@ -0,0 +1,529 @@
+#pragma once
+
+#include "BinaryProtocol.h"
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// The largest message is a header and a 64 KiB block, so a session's input buffer
+// of this size always has room for one complete message
+constexpr std::size_t SessionInputCapacity = 1 << 17;
+// A session whose unsent reports reach this is too slow and is disconnected
+constexpr std::size_t MaxPendingOutput = 1 << 26;
+
+// Owned file descriptor, closed on destruction
+class FileDescriptor {
+public:
+    FileDescriptor() = default;
+    explicit FileDescriptor(int fd) : fd_{fd} {}
+
+    FileDescriptor(FileDescriptor&& other) noexcept : fd_{std::exchange(other.fd_, -1)} {}
+
+    FileDescriptor& operator=(FileDescriptor&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            fd_ = std::exchange(other.fd_, -1);
+        }
+        return *this;
+    }
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    ~FileDescriptor() { Reset(); }
+
+    int Get() const { return fd_; }
+    bool IsValid() const { return fd_ >= 0; }
+
+    void Reset(int fd = -1) {
+        if (fd_ >= 0)
+            close(fd_);
+        fd_ = fd;
+    }
+
+private:
+    int fd_{-1};
+};
+
+// TCP listening socket on address:port; port 0 picks a free one. Invalid on
+// failure, with errno set.
+inline FileDescriptor OpenListener(const std::string& address, std::uint16_t port, int flags) {
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &local.sin_addr) != 1) {
+        errno = EINVAL;
+        return {};
+    }
+    FileDescriptor listener{ socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | flags, 0) };
+    int reuse = 1;
+    if (!listener.IsValid() ||
+        setsockopt(listener.Get(), SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(listener.Get(), reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 ||
+        listen(listener.Get(), SOMAXCONN) != 0)
+        return {};
+    return listener;
+}
+
+inline std::uint16_t GetListenerPort(const FileDescriptor& listener) {
+    sockaddr_in local{};
+    socklen_t length = sizeof(local);
+    if (getsockname(listener.Get(), reinterpret_cast<sockaddr*>(&local), &length) != 0)
+        return 0;
+    return ntohs(local.sin_port);
+}
+
+// Journal file opened for appending input records
+inline FileDescriptor OpenJournalFile(const std::string& path) {
+    return FileDescriptor{ open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) };
+}
+
+// Byte ring holding a session's outgoing reports. It grows when a burst outruns
+// the socket, and drains with one writev even when the data wraps.
+class OutputRing {
+public:
+    explicit OutputRing(std::size_t capacity) : data_(std::bit_ceil(capacity)) {}
+
+    bool Empty() const { return size_ == 0; }
+    std::size_t Size() const { return size_; }
+
+    void Append(std::span<const std::byte> bytes) {
+        if (data_.size() - size_ < bytes.size())
+            Grow(size_ + bytes.size());
+        std::size_t tail = (head_ + size_) & (data_.size() - 1);
+        std::size_t first = std::min(bytes.size(), data_.size() - tail);
+        std::copy_n(bytes.begin(), first, data_.begin() + static_cast<std::ptrdiff_t>(tail));
+        std::copy(bytes.begin() + static_cast<std::ptrdiff_t>(first), bytes.end(), data_.begin());
+        size_ += bytes.size();
+    }
+
+    // Write as much as the socket takes; false on a socket error. Counts the
+    // writev calls made in syscalls.
+    bool Flush(int fd, std::uint64_t& syscalls) {
+        while (size_ > 0) {
+            std::size_t first = std::min(size_, data_.size() - head_);
+            iovec segments[2] = {
+                { data_.data() + head_, first },
+                { data_.data(), size_ - first }
+            };
+            ++syscalls;
+            ssize_t written = writev(fd, segments, size_ > first ? 2 : 1);
+            if (written < 0)
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            head_ = (head_ + static_cast<std::size_t>(written)) & (data_.size() - 1);
+            size_ -= static_cast<std::size_t>(written);
+        }
+        head_ = 0;
+        return true;
+    }
+
+private:
+    void Grow(std::size_t required) {
+        std::vector<std::byte> grown(std::bit_ceil(required));
+        std::size_t first = std::min(size_, data_.size() - head_);
+        std::copy_n(data_.begin() + static_cast<std::ptrdiff_t>(head_), first, grown.begin());
+        std::copy_n(data_.begin(), size_ - first, grown.begin() + static_cast<std::ptrdiff_t>(first));
+        data_ = std::move(grown);
+        head_ = 0;
+    }
+
+    std::vector<std::byte> data_;
+    std::size_t head_{0};
+    std::size_t size_{0};
+};
+
+// Readiness-based I/O for OrderEntryServer: epoll, recv into each connection's
+// input buffer until it would block, one writev per connection written to, and
+// one pwrite of the journal per loop iteration, ahead of the reports.
+//
+// A backend hands the server connection ids starting at 1 and reused once the
+// connection is gone, and calls back into it:
+//   OnConnect(connection)
+//   OnReceive(connection, bytes) -> bytes consumed; the rest is offered again
+//   OnDisconnect(connection), unless the server closed the connection itself
+class EpollBackend {
+public:
+    static constexpr std::size_t OutputCapacity = 1 << 16;
+
+    bool Listen(const std::string& address, std::uint16_t port) {
+        epoll_.Reset(epoll_create1(EPOLL_CLOEXEC));
+        listener_ = OpenListener(address, port, SOCK_NONBLOCK);
+        return epoll_.IsValid() && listener_.IsValid() && Watch(EPOLL_CTL_ADD, listener_.Get(), EPOLLIN, ListenerTag);
+    }
+
+    std::uint16_t GetPort() const { return GetListenerPort(listener_); }
+
+    bool OpenJournal(const std::string& path) {
+        journal_ = OpenJournalFile(path);
+        return journal_.IsValid();
+    }
+
+    std::uint64_t GetSyscallCount() const { return syscalls_; }
+
+    // Wait up to timeout for readiness and deliver what arrived; false on an epoll
+    // failure, with errno set
+    template <typename Handler>
+    bool Poll(Handler& handler, int timeoutMilliseconds) {
+        constexpr int MaxEvents = 256;
+        epoll_event events[MaxEvents];
+        ++syscalls_;
+        int ready = epoll_wait(epoll_.Get(), events, MaxEvents, timeoutMilliseconds);
+        if (ready < 0)
+            return errno == EINTR;
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.u64 == ListenerTag) {
+                Accept(handler);
+                continue;
+            }
+            auto id = static_cast<std::uint32_t>(events[i].data.u64);
+            Connection* connection = Find(id);
+            if (connection == nullptr)
+                continue;
+            if (events[i].events & EPOLLIN)
+                Receive(id, *connection, handler);
+            else if (events[i].events & (EPOLLERR | EPOLLHUP))
+                Drop(id, handler);
+            if (events[i].events & EPOLLOUT)
+                MarkDirty(id, *connection);
+        }
+        return true;
+    }
+
+    // Queue bytes for the connection; false once it has too much unsent
+    bool Send(std::uint32_t id, std::span<const std::byte> bytes) {
+        Connection* connection = Find(id);
+        if (connection == nullptr || connection->output.Size() + bytes.size() > MaxPendingOutput)
+            return false;
+        connection->output.Append(bytes);
+        MarkDirty(id, *connection);
+        return true;
+    }
+
+    void Append(std::span<const std::byte> bytes) {
+        if (journal_.IsValid())
+            journalBuffer_.insert(journalBuffer_.end(), bytes.begin(), bytes.end());
+    }
+
+    // Write the journal, then everything queued for each connection. Sessions the
+    // socket cannot take everything from wait for EPOLLOUT. False if the journal
+    // cannot be written, with errno set.
+    template <typename Handler>
+    bool Flush(Handler& handler) {
+        if (!WriteJournal())
+            return false;
+        for (std::uint32_t id : dirty_) {
+            Connection* connection = Find(id);
+            if (connection == nullptr)
+                continue;
+            connection->dirty = false;
+            if (!connection->output.Flush(connection->fd.Get(), syscalls_)) {
+                Drop(id, handler);
+                continue;
+            }
+            bool waitWritable = !connection->output.Empty();
+            if (waitWritable != connection->waitingWritable) {
+                connection->waitingWritable = waitWritable;
+                std::uint32_t events = EPOLLIN | EPOLLRDHUP;
+                if (waitWritable)
+                    events |= EPOLLOUT;
+                Watch(EPOLL_CTL_MOD, connection->fd.Get(), events, id);
+            }
+        }
+        dirty_.clear();
+        Reclaim();
+        return true;
+    }
+
+    // Close without a callback. The id is reused after the current iteration, as
+    // events and queued flushes may still name it.
+    void Close(std::uint32_t id) {
+        Connection* connection = Find(id);
+        if (connection == nullptr)
+            return;
+        connection->open = false;
+        connection->fd.Reset();
+        closed_.push_back(id);
+    }
+
+private:
+    static constexpr std::uint64_t ListenerTag = 0;
+
+    struct Connection {
+        explicit Connection(int fd) : fd{fd}, input(SessionInputCapacity), output{OutputCapacity} {}
+
+        FileDescriptor fd;
+        std::vector<std::byte> input;
+        std::size_t inputSize{0};
+        OutputRing output;
+        bool dirty{false};              // Queued for the flush at the end of this iteration
+        bool waitingWritable{false};    // EPOLLOUT registered
+        bool open{true};
+    };
+
+    bool Watch(int operation, int fd, std::uint32_t events, std::uint64_t tag) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = tag;
+        ++syscalls_;
+        return epoll_ctl(epoll_.Get(), operation, fd, &event) == 0;
+    }
+
+    Connection* Find(std::uint32_t id) {
+        if (id == 0 || id > connections_.size())
+            return nullptr;
+        Connection* connection = connections_[id - 1].get();
+        return connection != nullptr && connection->open ? connection : nullptr;
+    }
+
+    template <typename Handler>
+    void Accept(Handler& handler) {
+        for (;;) {
+            ++syscalls_;
+            int fd = accept4(listener_.Get(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                return;
+            int noDelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+            std::uint32_t id;
+            if (!freeIds_.empty()) {
+                id = freeIds_.back();
+                freeIds_.pop_back();
+            } else {
+                connections_.emplace_back();
+                id = static_cast<std::uint32_t>(connections_.size());
+            }
+            connections_[id - 1] = std::make_unique<Connection>(fd);
+            if (!Watch(EPOLL_CTL_ADD, fd, EPOLLIN | EPOLLRDHUP, id)) {
+                connections_[id - 1].reset();
+                freeIds_.push_back(id);
+                continue;
+            }
+            handler.OnConnect(id);
+        }
+    }
+
+    // Read everything available, handing each batch over as it lands
+    template <typename Handler>
+    void Receive(std::uint32_t id, Connection& connection, Handler& handler) {
+        while (connection.open) {
+            ++syscalls_;
+            ssize_t received = recv(connection.fd.Get(), connection.input.data() + connection.inputSize,
+                                    connection.input.size() - connection.inputSize, 0);
+            if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                Drop(id, handler);
+                return;
+            }
+            if (received < 0)
+                return;
+            connection.inputSize += static_cast<std::size_t>(received);
+
+            std::size_t consumed = handler.OnReceive(id, std::span<const std::byte>{ connection.input.data(),
+                                                                                      connection.inputSize });
+            std::copy(connection.input.begin() + static_cast<std::ptrdiff_t>(consumed),
+                      connection.input.begin() + static_cast<std::ptrdiff_t>(connection.inputSize),
+                      connection.input.begin());
+            connection.inputSize -= consumed;
+        }
+    }
+
+    // Close a connection the peer or the socket gave up on
+    template <typename Handler>
+    void Drop(std::uint32_t id, Handler& handler) {
+        Close(id);
+        handler.OnDisconnect(id);
+    }
+
+    void MarkDirty(std::uint32_t id, Connection& connection) {
+        if (!connection.dirty) {
+            connection.dirty = true;
+            dirty_.push_back(id);
+        }
+    }
+
+    bool WriteJournal() {
+        std::size_t written = 0;
+        while (written < journalBuffer_.size()) {
+            ++syscalls_;
+            ssize_t result = pwrite(journal_.Get(), journalBuffer_.data() + written, journalBuffer_.size() - written,
+                                    static_cast<off_t>(journalOffset_ + written));
+            if (result < 0 && errno != EINTR)
+                return false;
+            written += static_cast<std::size_t>(std::max<ssize_t>(result, 0));
+        }
+        journalOffset_ += written;
+        journalBuffer_.clear();
+        return true;
+    }
+
+    void Reclaim() {
+        for (std::uint32_t id : closed_) {
+            connections_[id - 1].reset();
+            freeIds_.push_back(id);
+        }
+        closed_.clear();
+    }
+
+    FileDescriptor epoll_;
+    FileDescriptor listener_;
+    FileDescriptor journal_;
+    std::vector<std::byte> journalBuffer_;
+    std::uint64_t journalOffset_{0};
+    std::vector<std::unique_ptr<Connection>> connections_;
+    std::vector<std::uint32_t> freeIds_;
+    std::vector<std::uint32_t> dirty_;
+    std::vector<std::uint32_t> closed_;
+    std::uint64_t syscalls_{0};
+};
+
+// Single-threaded order entry server: each loop iteration waits on the backend
+// for client I/O, decodes every complete message received straight out of the
+// session's input buffer, applies it to the book and queues execution reports,
+// then has the backend flush the journal and every session written to at once.
+//
+// Each session is bound to its own owner id, so fills are routed by the owner of
+// each side of a trade, self-trade prevention works per session, and a session's
+// orders are cancelled when it disconnects. Order ids are per session: every
+// client may number its orders from 1, and its reports carry its own ids.
+//
+// With a journal open, each batch of messages decoded from one session is
+// appended as a record of the owner id and byte length (u32 little endian each)
+// followed by the messages, in the order they were applied.
+template <typename Book, typename Backend = EpollBackend>
+class OrderEntryServer {
+public:
+    explicit OrderEntryServer(Book& book, Backend backend = Backend{}) : book_{book}, backend_{std::move(backend)} {}
+
+    OrderEntryServer(const OrderEntryServer&) = delete;
+    OrderEntryServer& operator=(const OrderEntryServer&) = delete;
+
+    // False on failure, with errno set
+    bool Listen(const std::string& address, std::uint16_t port) { return backend_.Listen(address, port); }
+    bool OpenJournal(const std::string& path) { return backend_.OpenJournal(path); }
+
+    std::uint16_t GetPort() const { return backend_.GetPort(); }
+    std::size_t GetSessionCount() const { return sessionCount_; }
+    std::uint64_t GetMessageCount() const { return messages_; }
+    const Backend& GetBackend() const { return backend_; }
+
+    // Serve until stop is set; false on an I/O failure of the loop or the
+    // journal, with errno set
+    bool Run(const std::atomic<bool>& stop) { return Run(stop, [] { return true; }); }
+
+    // As above, calling onIteration() once the iteration's reports are flushed,
+    // with GetIterationTrades() holding every trade of the iteration; stops with
+    // false if it returns false
+    template <typename OnIteration>
+    bool Run(const std::atomic<bool>& stop, OnIteration&& onIteration) {
+        constexpr int TimeoutMilliseconds = 100;
+        while (!stop.load(std::memory_order_relaxed)) {
+            trades_.clear();
+            if (!backend_.Poll(*this, TimeoutMilliseconds) || !backend_.Flush(*this) || !onIteration())
+                return false;
+        }
+        return true;
+    }
+
+    std::span<const Trade> GetIterationTrades() const { return trades_; }
+
+    // Backend callbacks
+    void OnConnect(std::uint32_t ownerId) {
+        if (sessions_.size() < ownerId)
+            sessions_.resize(ownerId);
+        sessions_[ownerId - 1] = std::make_unique<Session>(book_, ownerId);
+        ++sessionCount_;
+    }
+
+    std::size_t OnReceive(std::uint32_t ownerId, std::span<const std::byte> input) {
+        Session& session = *sessions_[ownerId - 1];
+        std::size_t offset = 0;
+        while (session.open) {
+            auto result = session.protocol.Dispatch(input.subspan(offset));
+            if (result.status == DecodeStatus::Incomplete)
+                break;
+            offset += result.length;
+            ++messages_;
+            Report(session, result);
+        }
+        if (offset > 0) {
+            std::array<std::byte, 8> record;
+            LittleEndian::Store(record.data(), ownerId);
+            LittleEndian::Store(record.data() + 4, static_cast<std::uint32_t>(offset));
+            backend_.Append(record);
+            backend_.Append(input.first(offset));
+        }
+        return offset;
+    }
+
+    void OnDisconnect(std::uint32_t ownerId) { Disconnect(*sessions_[ownerId - 1]); }
+
+private:
+    // Replaced, not destroyed, when its owner id is reused, as a disconnect can
+    // happen while the session is still decoding
+    struct Session {
+        Session(Book& book, std::uint32_t ownerId) : ownerId{ownerId}, protocol{book, ownerId} {}
+
+        std::uint32_t ownerId;
+        ProtocolSession<Book> protocol;
+        bool open{true};
+    };
+
+    Session* Find(std::uint32_t ownerId) {
+        if (ownerId == AnonymousOwner || ownerId > sessions_.size())
+            return nullptr;
+        Session* session = sessions_[ownerId - 1].get();
+        return session != nullptr && session->open ? session : nullptr;
+    }
+
+    // Fills go to the owner of each side, both at the execution price, then the
+    // status to the sender
+    void Report(Session& session, const DecodeResult& result) {
+        std::array<std::byte, 32> message;
+        trades_.insert(trades_.end(), session.protocol.GetTrades().begin(), session.protocol.GetTrades().end());
+        for (const auto& trade : session.protocol.GetTrades()) {
+            for (const auto& fill : { trade.GetBidTrade(), trade.GetAskTrade() }) {
+                if (Session* owner = Find(fill.owner_id)) {
+                    TradeInfo report{ owner->protocol.ToClientId(fill.order_id), trade.GetPrice(), fill.quantity_,
+                                      fill.owner_id };
+                    Send(*owner, { message.data(), MessageEncoder::EncodeFillReport(message, report) });
+                }
+            }
+        }
+        auto cancelled = static_cast<std::uint32_t>(session.protocol.GetCancelled().size());
+        Send(session, { message.data(), MessageEncoder::EncodeStatusReport(message, result.orderId, result.type,
+                                                                            result.orderStatus, result.status,
+                                                                            cancelled) });
+    }
+
+    void Send(Session& session, std::span<const std::byte> message) {
+        if (session.open && !backend_.Send(session.ownerId, message)) {
+            Disconnect(session);
+            backend_.Close(session.ownerId);
+        }
+    }
+
+    void Disconnect(Session& session) {
+        if (!session.open)
+            return;
+        session.open = false;
+        book_.CancelOwnerOrders(session.ownerId);
+        --sessionCount_;
+    }
+
+    Book& book_;
+    Backend backend_;
+    std::vector<std::unique_ptr<Session>> sessions_;
+    std::size_t sessionCount_{0};
+    std::uint64_t messages_{0};
+    std::vector<Trade> trades_;
+};
@@ -0,0 +1,398 @@
+#pragma once
+
+#include "OrderBook.h"
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// POSIX shared-memory region, unmapped on destruction. The creator also removes
+// the name, so a restarted publisher starts from a fresh region.
+class SharedMemoryRegion {
+public:
+    // Create (or replace) a named region of size bytes, mapped read-write. Returns
+    // nullopt on failure; errno says why.
+    static std::optional<SharedMemoryRegion> Create(const std::string& name, std::size_t size) {
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0)
+            return std::nullopt;
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            int error = errno;
+            close(fd);
+            shm_unlink(name.c_str());
+            errno = error;
+            return std::nullopt;
+        }
+        return Map(name, fd, size, PROT_READ | PROT_WRITE, true);
+    }
+
+    // Map an existing region; read-only unless writable is set
+    static std::optional<SharedMemoryRegion> Open(const std::string& name, bool writable = false) {
+        int fd = shm_open(name.c_str(), writable ? O_RDWR : O_RDONLY, 0);
+        if (fd < 0)
+            return std::nullopt;
+        struct stat status;
+        if (fstat(fd, &status) != 0) {
+            int error = errno;
+            close(fd);
+            errno = error;
+            return std::nullopt;
+        }
+        return Map(name, fd, static_cast<std::size_t>(status.st_size),
+                   writable ? PROT_READ | PROT_WRITE : PROT_READ, false);
+    }
+
+    SharedMemoryRegion(SharedMemoryRegion&& other) noexcept
+            : name_{std::move(other.name_)}, data_{std::exchange(other.data_, nullptr)},
+              size_{std::exchange(other.size_, 0)}, owner_{std::exchange(other.owner_, false)} {}
+
+    SharedMemoryRegion& operator=(SharedMemoryRegion&& other) noexcept {
+        if (this != &other) {
+            Release();
+            name_ = std::move(other.name_);
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            owner_ = std::exchange(other.owner_, false);
+        }
+        return *this;
+    }
+
+    SharedMemoryRegion(const SharedMemoryRegion&) = delete;
+    SharedMemoryRegion& operator=(const SharedMemoryRegion&) = delete;
+
+    ~SharedMemoryRegion() { Release(); }
+
+    void* GetData() const { return data_; }
+    std::size_t GetSize() const { return size_; }
+
+private:
+    SharedMemoryRegion(std::string name, void* data, std::size_t size, bool owner)
+            : name_{std::move(name)}, data_{data}, size_{size}, owner_{owner} {}
+
+    static std::optional<SharedMemoryRegion> Map(const std::string& name, int fd, std::size_t size,
+                                                 int protection, bool owner) {
+        void* data = size == 0 ? MAP_FAILED : mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+        int error = size == 0 ? EINVAL : errno;
+        close(fd);
+        if (data == MAP_FAILED) {
+            if (owner)
+                shm_unlink(name.c_str());
+            errno = error;
+            return std::nullopt;
+        }
+        return SharedMemoryRegion{ name, data, size, owner };
+    }
+
+    void Release() {
+        if (data_ != nullptr)
+            munmap(data_, size_);
+        if (owner_)
+            shm_unlink(name_.c_str());
+        data_ = nullptr;
+        owner_ = false;
+    }
+
+    std::string name_;
+    void* data_{nullptr};
+    std::size_t size_{0};
+    bool owner_{false};
+};
+
+// Best bid/offer and top Depth levels for a set of instruments, published into
+// shared memory for strategies in other processes. Each instrument has its own
+// PublishedLevels seqlock, so a reader polls one instrument with plain loads and
+// no syscalls, and the publisher never waits for readers.
+template <std::size_t Depth>
+class SharedTopOfBook {
+    // Lock-free atomics are address-free, so they work across processes
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+
+    struct Header {
+        std::atomic<std::uint64_t> magic;
+        std::uint64_t depth;
+        std::uint64_t instruments;
+    };
+
+    static constexpr std::uint64_t Magic = 0x4f42'544f'4201;     // Bumped when the layout changes
+    static constexpr std::size_t SlotsOffset = (sizeof(Header) + alignof(PublishedLevels<Depth>) - 1) /
+                                               alignof(PublishedLevels<Depth>) * alignof(PublishedLevels<Depth>);
+
+public:
+    using View = typename PublishedLevels<Depth>::View;
+
+    static std::size_t GetRegionSize(std::uint32_t instruments) {
+        return SlotsOffset + instruments * sizeof(PublishedLevels<Depth>);
+    }
+
+    // Publisher side: create the region with an empty book for each instrument
+    static std::optional<SharedTopOfBook> Create(const std::string& name, std::uint32_t instruments) {
+        auto region = SharedMemoryRegion::Create(name, GetRegionSize(instruments));
+        if (!region)
+            return std::nullopt;
+        auto* bytes = static_cast<std::byte*>(region->GetData());
+        for (std::uint32_t i = 0; i < instruments; ++i)
+            new (bytes + SlotsOffset + i * sizeof(PublishedLevels<Depth>)) PublishedLevels<Depth>{};
+        // Written last, so a reader that sees the magic sees initialised slots
+        auto* header = new (bytes) Header{ 0, Depth, instruments };
+        header->magic.store(Magic, std::memory_order_release);
+        return SharedTopOfBook{ std::move(*region) };
+    }
+
+    // Reader side: map an existing region read-only. Fails with EINVAL if it was
+    // not created for this depth or is not initialised yet.
+    static std::optional<SharedTopOfBook> Open(const std::string& name) {
+        auto region = SharedMemoryRegion::Open(name);
+        if (!region)
+            return std::nullopt;
+        const auto* header = static_cast<const Header*>(region->GetData());
+        if (region->GetSize() < sizeof(Header) ||
+            header->magic.load(std::memory_order_acquire) != Magic ||
+            header->depth != Depth || region->GetSize() < GetRegionSize(static_cast<std::uint32_t>(header->instruments))) {
+            errno = EINVAL;
+            return std::nullopt;
+        }
+        return SharedTopOfBook{ std::move(*region) };
+    }
+
+    std::uint32_t GetInstrumentCount() const { return static_cast<std::uint32_t>(GetHeader().instruments); }
+
+    // Call after each batch of operations on the instrument's book; publisher side
+    // only, as readers map the region read-only
+    template <typename Book>
+    void Publish(std::uint32_t instrument, const Book& book) {
+        Slot(instrument).Publish(book);
+    }
+
+    // Copy a consistent view of the instrument's top levels
+    void Read(std::uint32_t instrument, View& view) const { Slot(instrument).Read(view); }
+
+    View Read(std::uint32_t instrument) const { return Slot(instrument).Read(); }
+
+private:
+    explicit SharedTopOfBook(SharedMemoryRegion region) : region_{std::move(region)} {}
+
+    const Header& GetHeader() const { return *static_cast<const Header*>(region_.GetData()); }
+
+    PublishedLevels<Depth>& Slot(std::uint32_t instrument) const {
+        auto* bytes = static_cast<std::byte*>(region_.GetData());
+        return *std::launder(reinterpret_cast<PublishedLevels<Depth>*>(
+                bytes + SlotsOffset + instrument * sizeof(PublishedLevels<Depth>)));
+    }
+
+    SharedMemoryRegion region_;
+};
+
+// Lock-free single-producer single-consumer ring of fixed-size records, placed in
+// shared memory so producer and consumer can be different processes. Each side
+// caches the other's index and only rereads it when the ring looks full or empty,
+// so an uncontended push or pop touches one shared cache line.
+template <typename Record, std::size_t Capacity>
+class SpscRing {
+    static_assert(std::has_single_bit(Capacity), "capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<Record>);
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+
+public:
+    bool TryPush(const Record& record) {
+        std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ == Capacity) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ == Capacity)
+                return false;
+        }
+        records_[tail & (Capacity - 1)] = record;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(Record& record) {
+        std::uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head == tailCache_) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head == tailCache_)
+                return false;
+        }
+        record = records_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<std::uint64_t> head_{0};     // Advanced by the consumer
+    std::uint64_t tailCache_{0};                        // Consumer only
+    alignas(64) std::atomic<std::uint64_t> tail_{0};     // Advanced by the producer
+    std::uint64_t headCache_{0};                        // Producer only
+    alignas(64) std::array<Record, Capacity> records_;
+};
+
+// Order entry command written by a gateway process
+struct OrderCommand {
+    enum class Kind : std::uint8_t {
+        Add,
+        Cancel,
+        Modify
+    };
+
+    Kind kind;
+    Side side;
+    OrderType type;
+    std::uint32_t ownerId;
+    std::uint64_t orderId;
+    std::int32_t price;
+    std::uint32_t quantity;
+    Timestamp expiry;
+};
+
+// Outcome of a command, or one side of a trade, sent back to the gateway. Every
+// command gets exactly one Status report, after the Fill reports it caused.
+struct ExecutionReport {
+    enum class Kind : std::uint8_t {
+        Status,
+        Fill
+    };
+
+    Kind kind;
+    OrderStatus status;         // Status reports only
+    std::uint32_t quantity;     // Fill reports only
+    std::uint64_t orderId;
+    std::int32_t price;         // Fill reports only; the execution price
+};
+
+// Order entry from another process over shared memory: a ring of commands into
+// the matcher and a ring of execution reports back, with no syscalls on the data
+// path. The matcher creates the region and calls Process in its loop; one gateway
+// process opens it, submits commands and polls reports.
+class SharedOrderGateway {
+public:
+    static constexpr std::size_t CommandCapacity = 1 << 16;
+    static constexpr std::size_t ReportCapacity = 1 << 18;
+
+    // Matcher side
+    static std::optional<SharedOrderGateway> Create(const std::string& name) {
+        auto region = SharedMemoryRegion::Create(name, sizeof(Layout));
+        if (!region)
+            return std::nullopt;
+        auto* layout = new (region->GetData()) Layout{};
+        layout->magic.store(Magic, std::memory_order_release);
+        return SharedOrderGateway{ std::move(*region) };
+    }
+
+    // Gateway side. Fails with EINVAL if the region is not an initialised gateway.
+    static std::optional<SharedOrderGateway> Open(const std::string& name) {
+        auto region = SharedMemoryRegion::Open(name, true);
+        if (!region)
+            return std::nullopt;
+        if (region->GetSize() < sizeof(Layout) ||
+            static_cast<const Layout*>(region->GetData())->magic.load(std::memory_order_acquire) != Magic) {
+            errno = EINVAL;
+            return std::nullopt;
+        }
+        return SharedOrderGateway{ std::move(*region) };
+    }
+
+    // Gateway side: false if the matcher is this far behind; poll reports and retry
+    bool Submit(const OrderCommand& command) { return GetLayout().commands.TryPush(command); }
+
+    bool PollReport(ExecutionReport& report) { return GetLayout().reports.TryPop(report); }
+
+    // Matcher side: apply up to limit queued commands to book and report the
+    // results. Never waits for the gateway: reports that do not fit in the ring are
+    // held here, in order, and no more commands are taken until they are delivered,
+    // so a stalled or dead gateway stops its own flow rather than the matcher.
+    // Returns the number of commands processed.
+    template <typename Book>
+    std::size_t Process(Book& book, std::size_t limit = CommandCapacity) {
+        auto& layout = GetLayout();
+        OrderCommand command;
+        std::size_t processed = 0;
+        for (; processed < limit && Deliver() && layout.commands.TryPop(command); ++processed) {
+            trades_.clear();
+            OrderStatus status = Apply(book, command);
+            for (const auto& trade : trades_) {
+                // Both sides at the execution price
+                Report(ExecutionReport{ ExecutionReport::Kind::Fill, OrderStatus::Accepted, trade.GetBidTrade().quantity_,
+                                        trade.GetBidTrade().order_id, trade.GetPrice() });
+                Report(ExecutionReport{ ExecutionReport::Kind::Fill, OrderStatus::Accepted, trade.GetAskTrade().quantity_,
+                                        trade.GetAskTrade().order_id, trade.GetPrice() });
+            }
+            Report(ExecutionReport{ ExecutionReport::Kind::Status, status, 0, command.orderId, 0 });
+        }
+        return processed;
+    }
+
+    // Reports waiting for room in the report ring
+    std::size_t GetPendingReportCount() const { return pending_.size(); }
+
+private:
+    struct Layout {
+        std::atomic<std::uint64_t> magic{0};
+        SpscRing<OrderCommand, CommandCapacity> commands;
+        SpscRing<ExecutionReport, ReportCapacity> reports;
+    };
+
+    static constexpr std::uint64_t Magic = 0x4f42'4757'4101;     // Bumped when the layout changes
+
+    explicit SharedOrderGateway(SharedMemoryRegion region) : region_{std::move(region)} {}
+
+    Layout& GetLayout() { return *std::launder(static_cast<Layout*>(region_.GetData())); }
+
+    // The gateway is another process, so its enums may hold anything, negative
+    // values included; each is checked against its listed values. The command kind
+    // is checked by the switch in Apply.
+    static bool IsValid(Side side) { return side == Side::Buy || side == Side::Sell; }
+
+    static bool IsValid(OrderType type) {
+        switch (type) {
+            case OrderType::GoodTillCancel:
+            case OrderType::FillAndKill:
+            case OrderType::GoodTillDate:
+            case OrderType::GoodForDay:
+                return true;
+        }
+        return false;
+    }
+
+    template <typename Book>
+    OrderStatus Apply(Book& book, const OrderCommand& command) {
+        switch (command.kind) {
+            case OrderCommand::Kind::Add:
+                if (!IsValid(command.side) || !IsValid(command.type))
+                    return OrderStatus::InvalidCommand;
+                return book.AddOrder(command.type, command.orderId, command.side, command.price, command.quantity,
+                                     command.ownerId, command.expiry, trades_);
+            case OrderCommand::Kind::Cancel:
+                return book.CancelOrder(command.orderId);
+            case OrderCommand::Kind::Modify:
+                if (!IsValid(command.side))
+                    return OrderStatus::InvalidCommand;
+                return book.MatchOrder(command.orderId, command.side, command.price, command.quantity, trades_);
+        }
+        return OrderStatus::InvalidCommand;
+    }
+
+    void Report(const ExecutionReport& report) {
+        if (!pending_.empty() || !GetLayout().reports.TryPush(report))
+            pending_.push_back(report);
+    }
+
+    // Move held reports into the ring; true once none are left
+    bool Deliver() {
+        auto& reports = GetLayout().reports;
+        while (!pending_.empty() && reports.TryPush(pending_.front()))
+            pending_.pop_front();
+        return pending_.empty();
+    }
+
+    SharedMemoryRegion region_;
+    std::vector<Trade> trades_;             // Matcher's scratch, never in shared memory
+    std::deque<ExecutionReport> pending_;   // Reports the ring had no room for
+};
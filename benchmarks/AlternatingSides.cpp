@@ -0,0 +1,86 @@
+// Benchmark: adds, cancels and crossing orders that alternate between buy and sell
+// on every operation, so no branch on the side can settle into one direction.
+// Reports the time per operation and fails if the book is left crossed.
+#include "../OrderBook.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+constexpr int Operations = 2'000'000;
+constexpr std::int32_t MidPrice = 10'000;
+
+struct Operation {
+    enum class Kind : std::uint8_t {
+        Add,
+        Cancel,
+        Cross
+    };
+
+    Kind kind;
+    Side side;
+    std::int32_t price;
+    std::uint32_t quantity;
+};
+
+// Drawn up front, so the timed loop only touches the book
+std::vector<Operation> MakeOperations() {
+    std::mt19937 random{ 3 };
+    std::vector<Operation> operations(Operations);
+    for (int i = 0; i < Operations; ++i) {
+        Side side = i & 1 ? Side::Buy : Side::Sell;
+        std::uint32_t draw = random() % 16;
+        auto offset = static_cast<std::int32_t>(random() % 32);
+        // As many cancels as adds, and crosses take the rest, so the book stays shallow
+        Operation::Kind kind = draw < 6 ? Operation::Kind::Add : draw < 12 ? Operation::Kind::Cancel
+                                                                           : Operation::Kind::Cross;
+        std::int32_t price = side == Side::Buy ? MidPrice - 1 - offset : MidPrice + offset;
+        if (kind == Operation::Kind::Cross)
+            price = side == Side::Buy ? MidPrice + 4 : MidPrice - 5;
+        operations[static_cast<std::size_t>(i)] = { kind, side, price, 1 + static_cast<std::uint32_t>(random() % 50) };
+    }
+    return operations;
+}
+
+}
+
+int main() {
+    auto operations = MakeOperations();
+    OrderBook book;
+    std::vector<Trade> trades;
+    std::vector<std::uint64_t> resting[2];      // Ids added per side, cancelled newest first
+    std::uint64_t nextId = 1, fills = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& operation : operations) {
+        auto& ids = resting[operation.side == Side::Buy ? 0 : 1];
+        if (operation.kind == Operation::Kind::Cancel) {
+            if (!ids.empty()) {
+                book.CancelOrder(ids.back());
+                ids.pop_back();
+            }
+            continue;
+        }
+        auto type = operation.kind == Operation::Kind::Add ? OrderType::GoodTillCancel : OrderType::FillAndKill;
+        trades.clear();
+        book.AddOrder(std::make_shared<Order>(type, nextId, operation.side, operation.price, operation.quantity),
+                      trades);
+        fills += trades.size();
+        if (type == OrderType::GoodTillCancel)
+            ids.push_back(nextId);
+        ++nextId;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    auto infos = book.GetOrderInfos();
+    if (!infos.GetBids().empty() && !infos.GetAsks().empty() &&
+        infos.GetBids().front().price >= infos.GetAsks().front().price) {
+        std::cerr << "book left crossed\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << Operations << " alternating operations, " << fills << " fills, " << elapsed.count() / Operations
+              << " ns/operation\n";
+    return EXIT_SUCCESS;
+}
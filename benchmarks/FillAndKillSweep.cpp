@@ -0,0 +1,51 @@
+// Benchmark: FillAndKill buys sweeping a deep ask ladder, most of them larger than
+// the liquidity they can reach. Fails if any residual is left resting.
+#include "../OrderBook.h"
+
+#include <chrono>
+#include <cstdlib>
+
+int main() {
+    constexpr int Rounds = 2'000;
+    constexpr std::int32_t Levels = 64;
+    constexpr int OrdersPerLevel = 4;
+    constexpr std::int32_t BasePrice = 10'000;
+    constexpr int Sweeps = 40;
+
+    OrderBook book;
+    std::vector<Trade> trades;
+    std::uint64_t nextId = 1;
+    std::size_t fills = 0;
+    std::chrono::duration<double, std::nano> elapsed{};
+
+    for (int round = 0; round < Rounds; ++round) {
+        for (std::int32_t level = 0; level < Levels; ++level)
+            for (int i = 0; i < OrdersPerLevel; ++i)
+                book.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, nextId++, Side::Sell,
+                                                      BasePrice + level, 10), trades);
+
+        // Each sweep takes a few levels; limits rise so later sweeps reach deeper,
+        // and the last ones outsize what is left
+        std::vector<std::shared_ptr<Order>> sweeps;
+        for (int i = 0; i < Sweeps; ++i)
+            sweeps.push_back(std::make_shared<Order>(OrderType::FillAndKill, nextId++, Side::Buy,
+                                                     BasePrice + i * Levels / Sweeps + 2, 90));
+
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& sweep : sweeps) {
+            trades.clear();
+            book.AddOrder(sweep, trades);
+            fills += trades.size();
+        }
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        if (book.GetLadder(Side::Buy).Size() != 0) {
+            std::cerr << "FillAndKill residual left resting in round " << round << '\n';
+            return EXIT_FAILURE;
+        }
+        book.CancelAllOrders();
+    }
+
+    std::cout << "fills " << fills << ", " << elapsed.count() / (Rounds * Sweeps) << " ns/sweep\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+// Benchmark: publishes the market data of a random order flow over loopback
+// multicast, at full rate (one publication per burst of book events) and
+// conflated, while a MarketDataClient in the same process rebuilds the book from
+// each feed. Reports the publication cost per burst, packets per burst
+// and messages per packet of each feed, and fails if a rebuilt book differs from
+// the real one after a publication, or a requested snapshot from the book, or a
+// trade prints at other than the resting order's price.
+#include "../MarketData.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+constexpr int Bursts = 20'000;
+constexpr int EventsPerBurst = 32;
+constexpr int SnapshotEvery = 1'000;        // Bursts between snapshot requests
+constexpr std::int32_t MidPrice = 10'000;
+constexpr std::chrono::microseconds BurstSpacing{ 10 };
+constexpr std::chrono::milliseconds ConflationInterval{ 1 };
+
+bool Matches(const L2Book& received, const OrderbookLevelInfos& expected) {
+    OrderbookLevelInfos levels;
+    received.GetOrderInfos(levels);
+    auto same = [](const std::vector<LevelInfo>& a, const std::vector<LevelInfo>& b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const LevelInfo& l, const LevelInfo& r) {
+            return l.price == r.price && l.quantity == r.quantity;
+        });
+    };
+    return same(levels.GetBids(), expected.GetBids()) && same(levels.GetAsks(), expected.GetAsks());
+}
+
+// A publisher and a client following it
+struct Feed {
+    explicit Feed(const char* name) : name{name} {}
+
+    const char* name;
+    std::optional<MarketDataClient> client;
+    std::optional<MarketDataPublisher> publisher;
+    std::chrono::duration<double, std::micro> elapsed{};
+    std::uint64_t snapshots{0};
+
+    bool Open(std::chrono::nanoseconds conflationInterval) {
+        // The client's snapshot requests need the port before the publisher binds it
+        FileDescriptor probe = OpenDatagramSocket("127.0.0.1", 0);
+        MarketDataConfig config{ "239.1.1.1", 0, 0, "127.0.0.1", GetListenerPort(probe) };
+        probe.Reset();
+        config.conflationInterval = conflationInterval;
+        if (!(client = MarketDataClient::Create(config)))
+            return false;
+        config.incrementalPort = client->GetIncrementalPort();
+        config.snapshotPort = client->GetSnapshotPort();
+        publisher = MarketDataPublisher::Create(config);
+        return publisher.has_value();
+    }
+
+    // Let the client read what was sent, serving the snapshot it asks for if it
+    // is not synchronized. Everything sent is in its receive buffers by now.
+    bool Receive(std::chrono::steady_clock::time_point now) {
+        if (!client->Poll(now))
+            return false;
+        if (client->IsSynchronized())
+            return true;
+        return publisher->ServiceSnapshotRequests() && client->Poll(now) && client->IsSynchronized();
+    }
+
+    // Publish the burst and, if it went out, check what the client rebuilt
+    bool Publish(const OrderBook<>& book, std::span<const Trade> trades, std::chrono::steady_clock::time_point now,
+                 int burst) {
+        std::uint64_t publications = publisher->GetPublicationCount();
+        auto start = std::chrono::steady_clock::now();
+        if (!publisher->Publish(book, trades, now)) {
+            std::perror("publish");
+            return false;
+        }
+        elapsed += std::chrono::steady_clock::now() - start;
+        if (publisher->GetPublicationCount() == publications)
+            return true;
+
+        if (!Receive(now) || client->GetNextSequence() != publisher->GetSequence() + 1 ||
+            !Matches(client->GetBook(), book.GetOrderInfos())) {
+            std::cerr << name << ": received book differs after burst " << burst << '\n';
+            return false;
+        }
+
+        if (burst % SnapshotEvery == 0) {
+            client->Resynchronize();
+            if (!Receive(now) || client->GetNextSequence() != publisher->GetSequence() + 1 ||
+                !Matches(client->GetBook(), book.GetOrderInfos())) {
+                std::cerr << name << ": snapshot at burst " << burst << " differs from the book\n";
+                return false;
+            }
+            ++snapshots;
+        }
+        return true;
+    }
+
+    void Report() const {
+        auto packets = static_cast<double>(publisher->GetPacketCount());
+        std::cout << name << ": " << elapsed.count() / Bursts << " us to publish a burst, " << packets / Bursts
+                  << " packets/burst, " << static_cast<double>(publisher->GetMessageCount()) / packets
+                  << " messages/packet, " << static_cast<double>(publisher->GetSyscallCount()) / Bursts
+                  << " syscalls/burst, " << publisher->GetPublicationCount() << " publications, "
+                  << publisher->GetConflator().GetCoalescedCount() << " held-back changes coalesced, "
+                  << client->GetTradeCount() << " trade prints, " << client->GetSnapshotCount()
+                  << " snapshots applied, " << client->GetGapCount() << " gaps recovered, "
+                  << publisher->GetDroppedCount() << " packets dropped\n";
+    }
+};
+
+// A buy through a lower ask must print at the ask's price, not at the buy's limit
+bool CheckTradePrice() {
+    Feed feed{ "trade price" };
+    if (!feed.Open(std::chrono::nanoseconds::zero())) {
+        std::perror("feed");
+        return false;
+    }
+    OrderBook book;
+    std::vector<Trade> trades;
+    auto now = std::chrono::steady_clock::now();
+    book.AddOrder(OrderType::GoodTillCancel, 1, Side::Sell, MidPrice, 10, AnonymousOwner, NoExpiry, trades);
+    if (!feed.Publish(book, trades, now, 1))
+        return false;
+    book.AddOrder(OrderType::GoodTillCancel, 2, Side::Buy, MidPrice + 5, 4, AnonymousOwner, NoExpiry, trades);
+    if (!feed.Publish(book, trades, now, 2))
+        return false;
+    const auto& print = feed.client->GetLastTrade();
+    if (trades.size() != 1 || !print || print->price != MidPrice || print->quantity != 4) {
+        std::cerr << "trade printed at " << (print ? print->price : 0) << " instead of " << MidPrice << '\n';
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main() {
+    // The full feed publishes every burst; the conflated one every 100 bursts of
+    // simulated time
+    if (!CheckTradePrice())
+        return EXIT_FAILURE;
+    Feed full{ "full rate" }, conflated{ "conflated" };
+    if (!full.Open(std::chrono::nanoseconds::zero()) || !conflated.Open(ConflationInterval)) {
+        std::perror("feed");
+        return EXIT_FAILURE;
+    }
+
+    OrderBook book;
+    std::mt19937 random{ 7 };
+    std::vector<Trade> trades;
+    std::vector<std::uint64_t> resting;
+    std::uint64_t nextId = 1, events = 0;
+    auto now = std::chrono::steady_clock::now();
+
+    for (int burst = 0; burst < Bursts; ++burst, now += BurstSpacing) {
+        trades.clear();
+        for (int i = 0; i < EventsPerBurst; ++i, ++events) {
+            std::uint32_t draw = random() % 16;
+            if (draw < 5 && !resting.empty()) {
+                std::size_t index = random() % resting.size();
+                book.CancelOrder(resting[index]);
+                resting[index] = resting.back();
+                resting.pop_back();
+                continue;
+            }
+            Side side = random() & 1 ? Side::Buy : Side::Sell;
+            auto offset = static_cast<std::int32_t>(random() % 20);
+            // A few orders cross the spread and trade
+            std::int32_t price = draw == 15 ? (side == Side::Buy ? MidPrice + 5 : MidPrice - 5)
+                                            : (side == Side::Buy ? MidPrice - 1 - offset : MidPrice + offset);
+            book.AddOrder(OrderType::GoodTillCancel, nextId, side, price, 1 + random() % 100, AnonymousOwner, NoExpiry,
+                          trades);
+            resting.push_back(nextId++);
+        }
+        if (!full.Publish(book, trades, now, burst) || !conflated.Publish(book, trades, now, burst))
+            return EXIT_FAILURE;
+    }
+
+    std::cout << events << " book events in " << Bursts << " bursts\n";
+    full.Report();
+    conflated.Report();
+    return EXIT_SUCCESS;
+}
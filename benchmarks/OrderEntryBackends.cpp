@@ -0,0 +1,106 @@
+// Benchmark: runs the order entry server in a child process on each I/O backend,
+// with and without a journal, and drives it over loopback with the load
+// generator's workload. Reports messages per second and the server's syscalls
+// per message for each, and fails if a run loses or reorders a report.
+#include "../IoUringBackend.h"
+#include "../tools/LoadGenerator.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+
+#include <sys/wait.h>
+
+namespace {
+
+constexpr std::uint64_t Sessions = 8;
+constexpr std::uint64_t Messages = 200'000;
+
+std::atomic<bool> stopRequested{ false };
+
+void RequestStop(int) { stopRequested.store(true, std::memory_order_relaxed); }
+
+// What the server child reports back through the pipe
+struct ServerStats {
+    std::uint64_t messages;
+    std::uint64_t syscalls;
+};
+
+template <typename Backend>
+int Serve(Backend backend, const std::string& journal, int pipe) {
+    OrderBook<> book;
+    OrderEntryServer server{ book, std::move(backend) };
+    if (!server.Listen("127.0.0.1", 0) || (!journal.empty() && !server.OpenJournal(journal)))
+        return EXIT_FAILURE;
+    std::uint16_t port = server.GetPort();
+    if (write(pipe, &port, sizeof(port)) != sizeof(port) || !server.Run(stopRequested))
+        return EXIT_FAILURE;
+    ServerStats stats{ server.GetMessageCount(), server.GetBackend().GetSyscallCount() };
+    return write(pipe, &stats, sizeof(stats)) == sizeof(stats) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool Measure(const char* name, bool ioUring, bool journaled) {
+    std::string journal = journaled ? (std::filesystem::temp_directory_path() / "orderbook-backend-journal").string()
+                                    : std::string{};
+    int pipes[2];
+    if (pipe(pipes) != 0) {
+        std::perror("pipe");
+        return false;
+    }
+    std::cout.flush();
+    pid_t server = fork();
+    if (server < 0) {
+        std::perror("fork");
+        return false;
+    }
+    if (server == 0) {
+        close(pipes[0]);
+        std::signal(SIGTERM, RequestStop);
+        // Created after the fork: the ring only accepts submissions from its creator
+        int status = EXIT_FAILURE;
+        if (!ioUring)
+            status = Serve(EpollBackend{}, journal, pipes[1]);
+        else if (auto backend = IoUringBackend::Create())
+            status = Serve(std::move(*backend), journal, pipes[1]);
+        std::_Exit(status);
+    }
+    close(pipes[1]);
+
+    std::uint16_t port = 0;
+    std::optional<LoadGenerator::Result> result;
+    if (read(pipes[0], &port, sizeof(port)) == sizeof(port))
+        result = LoadGenerator{ Sessions, Messages }.Run("127.0.0.1", port);
+    kill(server, SIGTERM);
+    ServerStats stats{};
+    bool reported = read(pipes[0], &stats, sizeof(stats)) == sizeof(stats);
+    close(pipes[0]);
+    int status = 0;
+    waitpid(server, &status, 0);
+    if (!journal.empty())
+        std::filesystem::remove(journal);
+
+    if (port == 0) {
+        std::cout << name << (journaled ? " + journal" : "") << ": unavailable\n";
+        return !ioUring;
+    }
+    if (!result || !reported || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        std::cerr << name << (journaled ? " + journal" : "") << ": run failed\n";
+        return false;
+    }
+    std::cout << name << (journaled ? " + journal" : "") << ": " << result->messages / result->seconds / 1e6
+              << " million messages/s, " << static_cast<double>(stats.syscalls) / static_cast<double>(stats.messages)
+              << " syscalls/message\n";
+    return true;
+}
+
+}
+
+int main() {
+    std::cout << Sessions << " sessions x " << Messages << " messages over loopback\n";
+    bool passed = true;
+    for (bool journaled : { false, true }) {
+        passed &= Measure("epoll", false, journaled);
+        passed &= Measure("io_uring", true, journaled);
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
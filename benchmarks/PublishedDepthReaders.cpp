@@ -0,0 +1,101 @@
+// Benchmark: reader threads load full-depth snapshots from a PublishedDepth while
+// the main thread republishes it as fast as it can, cycling through three books.
+// Each reader holds its snapshot for a while and checks it again, so a snapshot
+// refilled while still held is caught: with three books a refill always changes
+// the contents. Reports reads and publishes per second, and fails on a torn or
+// changed snapshot.
+#include "../OrderBook.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+namespace {
+
+constexpr std::int32_t Levels = 50;
+constexpr std::size_t Readers = 4;
+constexpr std::uint64_t Reads = 100'000;      // Per reader
+constexpr int HoldChecks = 4;                 // Times a held snapshot is checked again
+
+// Every level of the book holds the same quantity
+void FillBook(OrderBook<>& book, std::uint32_t quantity) {
+    std::vector<Trade> trades;
+    std::uint64_t nextId = 1;
+    for (std::int32_t level = 0; level < Levels; ++level) {
+        book.AddOrder(OrderType::GoodTillCancel, nextId++, Side::Buy, 1'000 - level, quantity, AnonymousOwner,
+                      NoExpiry, trades);
+        book.AddOrder(OrderType::GoodTillCancel, nextId++, Side::Sell, 1'001 + level, quantity, AnonymousOwner,
+                      NoExpiry, trades);
+    }
+}
+
+// The quantity every level of the snapshot holds, or 0 if it is torn
+std::uint32_t GetQuantity(const OrderbookLevelInfos& infos) {
+    const auto& bids = infos.GetBids();
+    const auto& asks = infos.GetAsks();
+    if (bids.size() != Levels || asks.size() != Levels)
+        return 0;
+    for (std::int32_t level = 0; level < Levels; ++level) {
+        const LevelInfo& bid = bids[static_cast<std::size_t>(level)];
+        const LevelInfo& ask = asks[static_cast<std::size_t>(level)];
+        if (bid.price != 1'000 - level || ask.price != 1'001 + level || bid.quantity != bids[0].quantity ||
+            ask.quantity != bids[0].quantity)
+            return 0;
+    }
+    return bids[0].quantity;
+}
+
+bool Read(const PublishedDepth& published) {
+    for (std::uint64_t i = 0; i < Reads; ++i) {
+        auto snapshot = published.Read();
+        std::uint32_t quantity = GetQuantity(*snapshot);
+        // Let the publisher run while the snapshot is held
+        for (int check = 0; quantity != 0 && check < HoldChecks; ++check) {
+            std::this_thread::yield();
+            if (GetQuantity(*snapshot) != quantity)
+                quantity = 0;
+        }
+        if (quantity == 0) {
+            std::cerr << "snapshot torn or changed while held at read " << i << '\n';
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main() {
+    OrderBook<> books[3];
+    FillBook(books[0], 5);
+    FillBook(books[1], 7);
+    FillBook(books[2], 9);
+    PublishedDepth published;
+    published.Publish(books[0]);
+
+    std::atomic<std::size_t> running{ Readers };
+    std::atomic<bool> failed{ false };
+    std::vector<std::thread> readers;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < Readers; ++i) {
+        readers.emplace_back([&] {
+            if (!Read(published))
+                failed.store(true, std::memory_order_relaxed);
+            running.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    std::uint64_t publishes = 0;
+    // Yielding keeps readers running alongside on a machine with few cores
+    while (running.load(std::memory_order_acquire) != 0) {
+        published.Publish(books[++publishes % 3]);
+        std::this_thread::yield();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    for (auto& reader : readers)
+        reader.join();
+
+    std::cout << Readers << " readers, " << Readers * Reads / elapsed.count() / 1e6 << " million reads/s, "
+              << publishes / elapsed.count() / 1e6 << " million publishes/s of " << 2 * Levels << " levels\n";
+    return failed.load() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
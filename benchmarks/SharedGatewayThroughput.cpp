@@ -0,0 +1,104 @@
+// Benchmark: a gateway process streams adds, cancels, modifies and crossing orders
+// through the shared-memory order gateway while this process runs the matcher.
+// Reports round-trip throughput and fails if a command's status report is missing
+// or out of order, or a fill is not at a resting order's price.
+#include "../SharedMemory.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+#include <sys/wait.h>
+
+namespace {
+
+constexpr std::uint64_t Commands = 2'000'000;
+const std::string RegionName = "/orderbook-shared-gateway-throughput";
+// Resting orders are priced within this range and crossing ones beyond it
+constexpr std::int32_t LowestResting = 993;
+constexpr std::int32_t HighestResting = 1'008;
+
+OrderCommand MakeCommand(std::uint64_t i) {
+    OrderCommand command{ OrderCommand::Kind::Add, i & 1 ? Side::Buy : Side::Sell, OrderType::GoodTillCancel,
+                          static_cast<std::uint32_t>(i % 7), i, 0, 10, NoExpiry };
+    command.price = command.side == Side::Buy ? 1'000 - static_cast<std::int32_t>(i % 8)
+                                              : 1'001 + static_cast<std::int32_t>(i % 8);
+    if (i % 4 == 3) {
+        command.kind = OrderCommand::Kind::Cancel;
+        command.orderId = i - 2;
+    } else if (i % 16 == 5) {
+        command.kind = OrderCommand::Kind::Modify;
+        command.orderId = i - 4;
+    } else if (i % 16 == 9) {
+        command.type = OrderType::FillAndKill;
+        command.price = command.side == Side::Buy ? 1'010 : 990;
+        command.quantity = 25;
+    }
+    return command;
+}
+
+int RunGateway() {
+    auto gateway = SharedOrderGateway::Open(RegionName);
+    if (!gateway) {
+        std::perror("open");
+        return EXIT_FAILURE;
+    }
+
+    std::uint64_t submitted = 0, statuses = 0, fills = 0;
+    ExecutionReport report;
+    auto start = std::chrono::steady_clock::now();
+    while (statuses < Commands) {
+        while (submitted < Commands && gateway->Submit(MakeCommand(submitted)))
+            ++submitted;
+        while (gateway->PollReport(report)) {
+            if (report.kind == ExecutionReport::Kind::Fill) {
+                if (report.price < LowestResting || report.price > HighestResting) {
+                    std::cerr << "order " << report.orderId << " filled at " << report.price << '\n';
+                    return EXIT_FAILURE;
+                }
+                ++fills;
+                continue;
+            }
+            if (report.orderId != MakeCommand(statuses).orderId) {
+                std::cerr << "status report " << statuses << " is for order " << report.orderId << '\n';
+                return EXIT_FAILURE;
+            }
+            ++statuses;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << Commands << " commands, " << fills << " fills, "
+              << Commands / elapsed.count() / 1e6 << " million commands/s\n";
+    return EXIT_SUCCESS;
+}
+
+}
+
+int main() {
+    auto gateway = SharedOrderGateway::Create(RegionName);
+    if (!gateway) {
+        std::perror("create");
+        return EXIT_FAILURE;
+    }
+
+    std::cout.flush();
+    pid_t child = fork();
+    if (child < 0) {
+        std::perror("fork");
+        return EXIT_FAILURE;
+    }
+    if (child == 0) {
+        int status = RunGateway();
+        std::cout.flush();
+        std::_Exit(status);
+    }
+
+    OrderBook<> book;
+    int status = 0;
+    while (waitpid(child, &status, WNOHANG) == 0) {
+        if (gateway->Process(book) == 0)
+            std::this_thread::yield();
+    }
+    std::cout << book.Size() << " orders resting at the end\n";
+    return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+// Benchmark: a child process polls a shared-memory top of book while the parent
+// republishes it as fast as it can, alternating between two books. Reports the
+// reader's latency per poll and fails if it ever sees a mix of the two books.
+#include "../SharedMemory.h"
+
+#include <chrono>
+#include <cstdlib>
+
+#include <sys/wait.h>
+
+namespace {
+
+constexpr std::size_t Depth = 10;
+constexpr std::uint32_t Instruments = 4;
+constexpr std::uint32_t Instrument = 2;
+const std::string RegionName = "/orderbook-shared-top-of-book-poll";
+
+// Every level of the book holds the same quantity
+void FillBook(OrderBook<>& book, std::uint32_t quantity) {
+    std::vector<Trade> trades;
+    std::uint64_t nextId = 1;
+    for (std::int32_t level = 0; level < static_cast<std::int32_t>(Depth); ++level) {
+        book.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, nextId++, Side::Buy, 1'000 - level, quantity), trades);
+        book.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, nextId++, Side::Sell, 1'001 + level, quantity), trades);
+    }
+}
+
+int Poll() {
+    constexpr int Polls = 10'000'000;
+    auto shared = SharedTopOfBook<Depth>::Open(RegionName);
+    if (!shared) {
+        std::perror("open");
+        return EXIT_FAILURE;
+    }
+
+    SharedTopOfBook<Depth>::View view;
+    std::uint64_t updates = 0, lastVersion = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < Polls; ++i) {
+        shared->Read(Instrument, view);
+        if (view.bidCount != Depth || view.askCount != Depth)
+            continue;
+        for (std::size_t level = 0; level < Depth; ++level) {
+            if (view.bids[level].quantity != view.bids[0].quantity || view.asks[level].quantity != view.bids[0].quantity) {
+                std::cerr << "torn read at version " << view.version << '\n';
+                return EXIT_FAILURE;
+            }
+        }
+        updates += view.version != lastVersion;
+        lastVersion = view.version;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << Polls << " polls, " << updates << " updates seen, " << elapsed.count() / Polls << " ns/poll\n";
+    return EXIT_SUCCESS;
+}
+
+}
+
+int main() {
+    auto shared = SharedTopOfBook<Depth>::Create(RegionName, Instruments);
+    if (!shared) {
+        std::perror("create");
+        return EXIT_FAILURE;
+    }
+    OrderBook<> books[2];
+    FillBook(books[0], 5);
+    FillBook(books[1], 7);
+    shared->Publish(Instrument, books[0]);
+
+    std::cout.flush();
+    pid_t reader = fork();
+    if (reader < 0) {
+        std::perror("fork");
+        return EXIT_FAILURE;
+    }
+    if (reader == 0) {
+        int status = Poll();
+        std::cout.flush();
+        std::_Exit(status);
+    }
+
+    int status = 0;
+    std::uint64_t publishes = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (waitpid(reader, &status, WNOHANG) == 0)
+        shared->Publish(Instrument, books[++publishes & 1]);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << publishes << " publishes, " << elapsed.count() / publishes << " ns/publish\n";
+    return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+}
@@ -0,0 +1,55 @@
+// Regression benchmark: rests 100k orders at a single price and checks that the
+// cost of an insert does not grow with the depth of the level's queue.
+#include "../OrderBook.h"
+
+#include <chrono>
+#include <cstdlib>
+
+int main() {
+    constexpr std::uint64_t Orders = 100'000;
+    constexpr std::uint64_t Chunk = 10'000;
+    constexpr int Rounds = 5;
+    // Allowed slowdown of inserts into the deeper half of the queue
+    constexpr double MaxRatio = 2.0;
+
+    std::vector<std::shared_ptr<Order>> orders;
+    orders.reserve(Orders);
+    for (std::uint64_t id = 1; id <= Orders; ++id)
+        orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, id, Side::Buy, 100, 10));
+
+    // Best time per chunk over several fresh books, to filter out noise
+    std::vector<double> best(Orders / Chunk, std::numeric_limits<double>::max());
+    std::vector<Trade> trades;
+    for (int round = 0; round < Rounds; ++round) {
+        OrderBook book;
+        for (std::uint64_t chunk = 0; chunk < Orders / Chunk; ++chunk) {
+            auto start = std::chrono::steady_clock::now();
+            for (std::uint64_t i = chunk * Chunk; i < (chunk + 1) * Chunk; ++i)
+                book.AddOrder(orders[i], trades);
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            best[chunk] = std::min(best[chunk], elapsed.count() / Chunk);
+        }
+        if (book.Size() != Orders || !trades.empty()) {
+            std::cerr << "unexpected book state after round " << round << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (std::size_t chunk = 0; chunk < best.size(); ++chunk)
+        std::cout << "orders " << (chunk + 1) * Chunk << ": " << best[chunk] << " ns/insert\n";
+
+    // Compare the median chunk of the deeper half with that of the shallower half,
+    // so one-off costs such as a rehash of the id table do not decide the result
+    auto median = [](std::vector<double> values) {
+        std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        return values[values.size() / 2];
+    };
+    std::size_t half = best.size() / 2;
+    double ratio = median({ best.begin() + half, best.end() }) / median({ best.begin(), best.begin() + half });
+    std::cout << "deep/shallow median: " << ratio << '\n';
+    if (ratio > MaxRatio) {
+        std::cerr << "insert cost grows with queue depth (limit " << MaxRatio << ")\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
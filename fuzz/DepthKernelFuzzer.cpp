@@ -0,0 +1,92 @@
+// Fuzz target: decodes bytes into depth ladders and queries, runs each vector
+// DepthKernels set the CPU supports and checks it returns exactly what the scalar
+// set does. Ladders have negative prices, quantities near 2^32 and lengths that
+// leave every tail size. Does nothing where neither set is available. Built and
+// driven like CrossingFuzzer.
+#include "FuzzDriver.h"
+
+namespace {
+
+constexpr std::size_t MaxLevels = 80;       // Several AVX-512 blocks and every tail
+constexpr std::int32_t PriceStep = 32;      // Bounded prices stay within +-2^20
+
+// Bounded prices keep any ladder's notional within 64 bits, so takeWhole can be
+// compared too; unbounded ones span the whole int32 range
+std::int32_t Price(FuzzInput& input, bool bounded) {
+    if (bounded)
+        return static_cast<std::int16_t>(input.Byte() << 8 | input.Byte()) * PriceStep;
+    switch (input.Byte() % 4) {
+        case 0:
+            return std::numeric_limits<std::int32_t>::min() + input.Byte();
+        case 1:
+            return std::numeric_limits<std::int32_t>::max() - input.Byte();
+        default:
+            return static_cast<std::int32_t>(input.Word());
+    }
+}
+
+std::uint32_t Quantity(FuzzInput& input) {
+    switch (input.Byte() % 4) {
+        case 0:
+            return input.Byte();
+        case 1:
+            return std::numeric_limits<std::uint32_t>::max() - input.Byte();
+        default:
+            return input.Word();
+    }
+}
+
+void Compare(const DepthKernels& kernels, FuzzInput& input) {
+    const DepthKernels scalar = DepthKernels::Scalar();
+    bool bounded = input.Byte() & 1;
+    std::size_t count = input.Byte() % (MaxLevels + 1);
+    std::vector<std::int32_t> prices(count);
+    std::vector<std::uint32_t> quantities(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        prices[i] = Price(input, bounded);
+        quantities[i] = Quantity(input);
+    }
+
+    std::vector<std::uint64_t> expected(count), actual(count);
+    scalar.prefixSum(quantities.data(), count, expected.data());
+    kernels.prefixSum(quantities.data(), count, actual.data());
+    Check(expected == actual, "prefixSum differs from scalar");
+
+    std::int32_t low = Price(input, bounded), high = Price(input, bounded);
+    if (input.Byte() & 1)
+        std::swap(low, high);
+    Check(kernels.sumWithin(prices.data(), quantities.data(), count, low, high) ==
+          scalar.sumWithin(prices.data(), quantities.data(), count, low, high), "sumWithin differs from scalar");
+
+    if (!bounded)
+        return;
+    // Targets up to a little past the ladder's total, from a running fill
+    std::uint64_t total = count == 0 ? 0 : expected.back();
+    std::uint64_t target = input.Byte() & 1 ? total + input.Byte()
+                                            : (std::uint64_t{ input.Word() } << 8) % (total + 2);
+    std::uint64_t startQuantity = input.Byte() & 1 ? input.Byte() : 0;
+    std::int64_t startNotional = static_cast<std::int8_t>(input.Byte());
+    std::uint64_t expectedQuantity = startQuantity, actualQuantity = startQuantity;
+    std::int64_t expectedNotional = startNotional, actualNotional = startNotional;
+    std::size_t expectedLevels = scalar.takeWhole(prices.data(), quantities.data(), count, target, expectedQuantity,
+                                                  expectedNotional);
+    std::size_t actualLevels = kernels.takeWhole(prices.data(), quantities.data(), count, target, actualQuantity,
+                                                 actualNotional);
+    Check(actualLevels == expectedLevels, "takeWhole took a different number of levels than scalar");
+    Check(actualQuantity == expectedQuantity, "takeWhole quantity differs from scalar");
+    Check(actualNotional == expectedNotional, "takeWhole notional differs from scalar");
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+    static const std::optional<DepthKernels> vectorKernels[] = { DepthKernels::Avx2(), DepthKernels::Avx512() };
+    FuzzInput input{ data, size };
+    while (!input.Empty()) {
+        const auto& kernels = vectorKernels[input.Byte() & 1];
+        if (!kernels)
+            continue;
+        Compare(*kernels, input);
+    }
+    return 0;
+}
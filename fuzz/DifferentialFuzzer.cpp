@@ -0,0 +1,467 @@
+// Differential fuzz target: decodes bytes into commands, applies each to OrderBook
+// and to ReferenceBook, a deliberately naive model kept as sorted vectors, and
+// aborts as soon as their statuses, trades, removed ids or aggregated levels
+// differ. Any faster backend must stay bit-exact with the reference. Built and
+// driven like CrossingFuzzer.
+#include "FuzzDriver.h"
+
+#include <algorithm>
+#include <span>
+
+namespace {
+
+// The matching rules written out as directly as possible: each side is one vector
+// of orders in priority order, every operation is a linear scan, and aggregates
+// are recomputed from scratch whenever they are needed.
+class ReferenceBook {
+public:
+    ReferenceBook(MatchingPolicy policy, SelfTradePrevention selfTradePrevention)
+            : policy_{policy}, selfTradePrevention_{selfTradePrevention} {}
+
+    OrderStatus AddOrder(const Order& order, std::vector<Trade>& trades) {
+        if (order.GetRemainingQuantity() == 0)
+            return OrderStatus::InvalidQuantity;
+        if (Find(order.GetOrderId()))
+            return OrderStatus::DuplicateId;
+
+        RestingOrder incoming{ order.GetOrderId(), order.GetSide(), order.GetPrice(), order.GetRemainingQuantity(),
+                               order.GetOwnerId(), order.GetOrderType(), order.GetExpiry(), NoExpiry, 0 };
+        bool crosses = Crosses(incoming);
+        if (incoming.type == OrderType::FillAndKill && (auction_ || !crosses))
+            return OrderStatus::WouldNotMatch;
+        if (incoming.type == OrderType::GoodTillDate)
+            incoming.expiresAt = incoming.expiry;
+        else if (incoming.type == OrderType::GoodForDay)
+            incoming.expiresAt = endOfDay_;
+        if (incoming.expiresAt <= now_)
+            return OrderStatus::Expired;
+        incoming.sequence = nextSequence_++;
+
+        if (!auction_ && crosses)
+            Match(incoming, trades);
+        if (incoming.quantity > 0 && incoming.type != OrderType::FillAndKill) {
+            auto& orders = Orders(incoming.side);
+            orders.insert(std::upper_bound(orders.begin(), orders.end(), incoming, Priority), incoming);
+        }
+        return OrderStatus::Accepted;
+    }
+
+    OrderStatus CancelOrder(std::uint64_t orderId) {
+        if (!Find(orderId))
+            return OrderStatus::UnknownId;
+        return Remove([&](const RestingOrder& order) { return order.id == orderId; }).empty()
+                ? OrderStatus::UnknownId : OrderStatus::Accepted;
+    }
+
+    OrderStatus MatchOrder(const OrderModify& modify, std::vector<Trade>& trades) {
+        const RestingOrder* existing = Find(modify.GetOrderId());
+        if (!existing)
+            return OrderStatus::UnknownId;
+        if (modify.GetQuantity() == 0)
+            return OrderStatus::InvalidQuantity;
+
+        auto order = modify.ToOrderPointer(existing->type, existing->owner, existing->expiry);
+        CancelOrder(modify.GetOrderId());
+        return AddOrder(*order, trades);
+    }
+
+    std::vector<std::uint64_t> CancelAllOrders() {
+        return Remove([](const RestingOrder&) { return true; });
+    }
+
+    std::vector<std::uint64_t> CancelOrders(Side side) {
+        return Remove([&](const RestingOrder& order) { return order.side == side; });
+    }
+
+    std::vector<std::uint64_t> CancelOrders(Side side, std::int32_t minPrice, std::int32_t maxPrice) {
+        return Remove([&](const RestingOrder& order) {
+            return order.side == side && order.price >= minPrice && order.price <= maxPrice;
+        });
+    }
+
+    std::vector<std::uint64_t> CancelOwnerOrders(std::uint32_t ownerId) {
+        if (ownerId == AnonymousOwner)
+            return {};
+        return Remove([&](const RestingOrder& order) { return order.owner == ownerId; });
+    }
+
+    void SetEndOfDay(Timestamp endOfDay) { endOfDay_ = endOfDay; }
+
+    std::vector<std::uint64_t> ExpireOrders(Timestamp now) {
+        now_ = std::max(now_, now);
+        return Remove([&](const RestingOrder& order) { return order.expiresAt <= now_; });
+    }
+
+    void StartAuction() { auction_ = true; }
+
+    // Repeatedly trade the front orders at the best equilibrium until the book no
+    // longer crosses
+    std::vector<Trade> Uncross() {
+        std::vector<Trade> trades;
+        auction_ = false;
+        while (auto equilibrium = Equilibrium()) {
+            auto [price, remaining] = *equilibrium;
+            while (remaining > 0 && !bids_.empty() && !asks_.empty() &&
+                   bids_.front().price >= price && asks_.front().price <= price) {
+                RestingOrder& bid = bids_.front();
+                RestingOrder& ask = asks_.front();
+                if (bid.owner == ask.owner && PreventSelfTrade(bid.sequence > ask.sequence ? bid : ask,
+                                                               bid.sequence > ask.sequence ? ask : bid)) {
+                    DropFilled();
+                    continue;
+                }
+                std::uint32_t quantity = static_cast<std::uint32_t>(
+                        std::min<std::uint64_t>(remaining, std::min(bid.quantity, ask.quantity)));
+                bid.quantity -= quantity;
+                ask.quantity -= quantity;
+                remaining -= quantity;
+                trades.push_back(Trade{ TradeInfo{ bid.id, price, quantity, bid.owner },
+                                        TradeInfo{ ask.id, price, quantity, ask.owner }, price });
+                DropFilled();
+            }
+        }
+        return trades;
+    }
+
+    OrderbookLevelInfos GetOrderInfos() const { return OrderbookLevelInfos{ Levels(bids_), Levels(asks_) }; }
+
+private:
+    struct RestingOrder {
+        std::uint64_t id;
+        Side side;
+        std::int32_t price;
+        std::uint32_t quantity;
+        std::uint32_t owner;
+        OrderType type;
+        Timestamp expiry;       // As submitted, kept across modifies
+        Timestamp expiresAt;    // When the book removes it
+        std::uint64_t sequence;
+    };
+
+    // Better price first, then earlier arrival
+    static bool Priority(const RestingOrder& left, const RestingOrder& right) {
+        if (left.price != right.price)
+            return left.side == Side::Buy ? left.price > right.price : left.price < right.price;
+        return left.sequence < right.sequence;
+    }
+
+    std::vector<RestingOrder>& Orders(Side side) { return side == Side::Buy ? bids_ : asks_; }
+
+    const RestingOrder* Find(std::uint64_t orderId) const {
+        for (const auto* orders : { &bids_, &asks_ })
+            for (const auto& order : *orders)
+                if (order.id == orderId)
+                    return &order;
+        return nullptr;
+    }
+
+    template <typename Predicate>
+    std::vector<std::uint64_t> Remove(Predicate predicate) {
+        std::vector<std::uint64_t> removed;
+        for (auto* orders : { &bids_, &asks_ }) {
+            for (const auto& order : *orders)
+                if (predicate(order))
+                    removed.push_back(order.id);
+            std::erase_if(*orders, predicate);
+        }
+        return removed;
+    }
+
+    void DropFilled() {
+        for (auto* orders : { &bids_, &asks_ })
+            std::erase_if(*orders, [](const RestingOrder& order) { return order.quantity == 0; });
+    }
+
+    static bool Crosses(const RestingOrder& incoming, const RestingOrder& resting) {
+        return incoming.side == Side::Buy ? incoming.price >= resting.price : incoming.price <= resting.price;
+    }
+
+    bool Crosses(const RestingOrder& incoming) {
+        const auto& opposite = Orders(incoming.side == Side::Buy ? Side::Sell : Side::Buy);
+        return !opposite.empty() && Crosses(incoming, opposite.front());
+    }
+
+    // Returns true if the two orders of one owner must not trade, after zeroing or
+    // reducing whichever the mode says. Zeroed orders are dropped by the caller.
+    bool PreventSelfTrade(RestingOrder& newer, RestingOrder& older) {
+        if (selfTradePrevention_ == SelfTradePrevention::None || newer.owner == AnonymousOwner)
+            return false;
+        switch (selfTradePrevention_) {
+            case SelfTradePrevention::CancelNewest:
+                newer.quantity = 0;
+                break;
+            case SelfTradePrevention::CancelOldest:
+                older.quantity = 0;
+                break;
+            case SelfTradePrevention::CancelBoth:
+                newer.quantity = 0;
+                older.quantity = 0;
+                break;
+            case SelfTradePrevention::Decrement: {
+                std::uint32_t quantity = std::min(newer.quantity, older.quantity);
+                newer.quantity -= quantity;
+                older.quantity -= quantity;
+                break;
+            }
+            case SelfTradePrevention::None:
+                break;
+        }
+        return true;
+    }
+
+    void Fill(RestingOrder& incoming, RestingOrder& resting, std::uint32_t quantity, std::vector<Trade>& trades) {
+        incoming.quantity -= quantity;
+        resting.quantity -= quantity;
+        TradeInfo incomingTrade{ incoming.id, incoming.price, quantity, incoming.owner };
+        TradeInfo restingTrade{ resting.id, resting.price, quantity, resting.owner };
+        trades.push_back(incoming.side == Side::Buy ? Trade{ incomingTrade, restingTrade, resting.price }
+                                                    : Trade{ restingTrade, incomingTrade, resting.price });
+    }
+
+    // Continuous matching of an incoming order against the opposite side, one price
+    // level at a time
+    void Match(RestingOrder& incoming, std::vector<Trade>& trades) {
+        auto& opposite = Orders(incoming.side == Side::Buy ? Side::Sell : Side::Buy);
+        while (incoming.quantity > 0 && !opposite.empty() && Crosses(incoming, opposite.front())) {
+            std::int32_t price = opposite.front().price;
+            auto levelEnd = std::find_if(opposite.begin(), opposite.end(),
+                                         [&](const RestingOrder& order) { return order.price != price; });
+            std::span<RestingOrder> level{ opposite.begin(), levelEnd };
+
+            if (policy_ == MatchingPolicy::Fifo) {
+                for (auto& resting : level) {
+                    while (incoming.quantity > 0 && resting.quantity > 0) {
+                        if (incoming.owner == resting.owner && PreventSelfTrade(incoming, resting))
+                            continue;
+                        Fill(incoming, resting, std::min(incoming.quantity, resting.quantity), trades);
+                    }
+                }
+            } else {
+                MatchProRata(incoming, level, trades);
+            }
+            DropFilled();
+        }
+    }
+
+    void MatchProRata(RestingOrder& incoming, std::span<RestingOrder> level, std::vector<Trade>& trades) {
+        if (selfTradePrevention_ != SelfTradePrevention::None && incoming.owner != AnonymousOwner) {
+            for (auto& resting : level)
+                if (incoming.quantity > 0 && resting.quantity > 0 && resting.owner == incoming.owner)
+                    PreventSelfTrade(incoming, resting);
+        }
+
+        auto live = [](const RestingOrder& order) { return order.quantity > 0; };
+        auto top = std::find_if(level.begin(), level.end(), live);
+        if (incoming.quantity == 0 || top == level.end())
+            return;
+        if (policy_ == MatchingPolicy::FifoProRata)
+            Fill(incoming, *top, std::min(incoming.quantity, top->quantity), trades);
+
+        std::uint64_t total = 0;
+        for (const auto& resting : level)
+            total += resting.quantity;
+        const std::uint64_t matched = std::min<std::uint64_t>(incoming.quantity, total);
+        std::uint64_t cumulative = 0;
+        std::uint64_t allocated = 0;
+        for (auto& resting : level) {
+            if (allocated == matched)
+                break;
+            if (resting.quantity == 0)
+                continue;
+            cumulative += resting.quantity;
+            std::uint64_t target = cumulative * matched / total;
+            auto quantity = static_cast<std::uint32_t>(target - allocated);
+            allocated = target;
+            if (quantity > 0)
+                Fill(incoming, resting, quantity, trades);
+        }
+    }
+
+    // Price maximising executed volume, then minimising imbalance, with ties going
+    // to the higher price under buy pressure; tried at every price either side rests
+    std::optional<std::pair<std::int32_t, std::uint64_t>> Equilibrium() const {
+        if (bids_.empty() || asks_.empty() || bids_.front().price < asks_.front().price)
+            return std::nullopt;
+
+        std::vector<std::int32_t> prices;
+        for (const auto* orders : { &bids_, &asks_ })
+            for (const auto& order : *orders)
+                if (order.price >= asks_.front().price && order.price <= bids_.front().price)
+                    prices.push_back(order.price);
+        std::sort(prices.begin(), prices.end());
+        prices.erase(std::unique(prices.begin(), prices.end()), prices.end());
+
+        std::optional<std::pair<std::int32_t, std::uint64_t>> best;
+        std::int64_t bestImbalance = 0;
+        for (std::int32_t price : prices) {
+            std::uint64_t buyVolume = 0, sellVolume = 0;
+            for (const auto& bid : bids_)
+                buyVolume += bid.price >= price ? bid.quantity : 0;
+            for (const auto& ask : asks_)
+                sellVolume += ask.price <= price ? ask.quantity : 0;
+            std::uint64_t volume = std::min(buyVolume, sellVolume);
+            std::int64_t imbalance = static_cast<std::int64_t>(buyVolume) - static_cast<std::int64_t>(sellVolume);
+            if (volume == 0)
+                continue;
+            if (!best || volume > best->second ||
+                (volume == best->second && (std::abs(imbalance) < std::abs(bestImbalance) ||
+                                            (std::abs(imbalance) == std::abs(bestImbalance) && imbalance > 0)))) {
+                best = { price, volume };
+                bestImbalance = imbalance;
+            }
+        }
+        return best;
+    }
+
+    static std::vector<LevelInfo> Levels(const std::vector<RestingOrder>& orders) {
+        std::vector<LevelInfo> levels;
+        for (const auto& order : orders) {
+            if (levels.empty() || levels.back().price != order.price)
+                levels.push_back(LevelInfo{ order.price, 0 });
+            levels.back().quantity += order.quantity;
+        }
+        return levels;
+    }
+
+    MatchingPolicy policy_;
+    SelfTradePrevention selfTradePrevention_;
+    std::vector<RestingOrder> bids_;
+    std::vector<RestingOrder> asks_;
+    bool auction_{false};
+    Timestamp now_{0};
+    Timestamp endOfDay_{NoExpiry};
+    std::uint64_t nextSequence_{0};
+};
+
+constexpr std::uint32_t Owners = 4;
+
+void CompareTrades(const std::vector<Trade>& actual, const std::vector<Trade>& expected) {
+    Check(actual.size() == expected.size(), "trade count");
+    for (std::size_t i = 0; i < actual.size(); ++i) {
+        Check(actual[i].GetPrice() == expected[i].GetPrice(), "execution price");
+        for (auto [side, expectedSide] : { std::pair{ actual[i].GetBidTrade(), expected[i].GetBidTrade() },
+                                           std::pair{ actual[i].GetAskTrade(), expected[i].GetAskTrade() } }) {
+            Check(side.order_id == expectedSide.order_id, "trade order id");
+            Check(side.price_ == expectedSide.price_, "trade price");
+            Check(side.quantity_ == expectedSide.quantity_, "trade quantity");
+            Check(side.owner_id == expectedSide.owner_id, "trade owner");
+        }
+    }
+}
+
+// Mass cancels and expiry report ids in whatever order the book found them
+void CompareIds(std::vector<std::uint64_t> actual, std::vector<std::uint64_t> expected) {
+    std::sort(actual.begin(), actual.end());
+    std::sort(expected.begin(), expected.end());
+    Check(actual == expected, "removed order ids");
+}
+
+void CompareLevels(const std::vector<LevelInfo>& actual, const std::vector<LevelInfo>& expected) {
+    Check(actual.size() == expected.size(), "level count");
+    for (std::size_t i = 0; i < actual.size(); ++i) {
+        Check(actual[i].price == expected[i].price, "level price");
+        Check(actual[i].quantity == expected[i].quantity, "level quantity");
+    }
+}
+
+template <MatchingPolicy Policy>
+void Run(FuzzInput& input, SelfTradePrevention selfTradePrevention) {
+    OrderBook<Policy> book{ selfTradePrevention };
+    ReferenceBook reference{ Policy, selfTradePrevention };
+    std::vector<std::uint64_t> ids;
+    std::vector<Trade> trades, expectedTrades;
+    OrderbookLevelInfos actual;
+    std::vector<LevelInfo> levels;
+    std::uint64_t nextId = 1;
+    Timestamp now = 0;
+    book.SetEndOfDay(10'000);
+    reference.SetEndOfDay(10'000);
+
+    while (!input.Empty()) {
+        trades.clear();
+        expectedTrades.clear();
+        std::uint8_t op = input.Byte() % 16;
+        if (op <= 6) {
+            Side side = TakeSide(input);
+            std::int32_t price = Price(input);
+            std::uint32_t quantity = input.Byte() % 64;
+            auto type = static_cast<OrderType>(input.Byte() % 4);
+            std::uint32_t ownerId = input.Byte() % Owners;
+            Timestamp expiry = now + input.Byte();
+            // Occasionally reuse an id to exercise duplicate rejection
+            std::uint64_t id = !ids.empty() && op == 6 ? ids[input.Byte() % ids.size()] : nextId++;
+            Order order{ type, id, side, price, quantity, ownerId, expiry };
+            Check(book.AddOrder(std::make_shared<Order>(order), trades) == reference.AddOrder(order, expectedTrades),
+                  "add status");
+            ids.push_back(id);
+        } else if (op <= 8) {
+            if (!ids.empty()) {
+                std::uint64_t id = ids[input.Byte() % ids.size()];
+                Check(book.CancelOrder(id) == reference.CancelOrder(id), "cancel status");
+            }
+        } else if (op == 9) {
+            if (!ids.empty()) {
+                std::uint64_t id = ids[input.Byte() % ids.size()];
+                Side side = TakeSide(input);
+                std::int32_t price = Price(input);
+                OrderModify modify{ id, side, price, input.Byte() % 64u };
+                Check(book.MatchOrder(modify, trades) == reference.MatchOrder(modify, expectedTrades),
+                      "modify status");
+            }
+        } else if (op == 10) {
+            now += input.Byte();
+            CompareIds(book.ExpireOrders(now), reference.ExpireOrders(now));
+        } else if (op == 11) {
+            book.StartAuction();
+            reference.StartAuction();
+        } else if (op == 12) {
+            trades = book.Uncross();
+            expectedTrades = reference.Uncross();
+        } else if (op == 13) {
+            std::uint32_t ownerId = input.Byte() % Owners;
+            CompareIds(book.CancelOwnerOrders(ownerId), reference.CancelOwnerOrders(ownerId));
+        } else if (op == 14) {
+            Side side = TakeSide(input);
+            std::int32_t first = Price(input);
+            std::int32_t second = Price(input);
+            CompareIds(book.CancelOrders(side, std::min(first, second), std::max(first, second)),
+                       reference.CancelOrders(side, std::min(first, second), std::max(first, second)));
+        } else if (input.Byte() & 1) {
+            Side side = TakeSide(input);
+            CompareIds(book.CancelOrders(side), reference.CancelOrders(side));
+        } else {
+            CompareIds(book.CancelAllOrders(), reference.CancelAllOrders());
+        }
+
+        CompareTrades(trades, expectedTrades);
+        // The snapshot is refilled in place, as a periodic publisher would use it
+        book.GetOrderInfos(actual);
+        auto expected = reference.GetOrderInfos();
+        CompareLevels(actual.GetBids(), expected.GetBids());
+        CompareLevels(actual.GetAsks(), expected.GetAsks());
+        levels.resize(book.GetLevelCount(Side::Sell));
+        levels.resize(book.GetLevelInfos(Side::Sell, levels));
+        CompareLevels(levels, expected.GetAsks());
+        Check(book.GetStats().verificationFailures == 0, "internal check failed");
+    }
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+    FuzzInput input{ data, size };
+    std::uint8_t config = input.Byte();
+    auto selfTradePrevention = static_cast<SelfTradePrevention>(config % 5);
+    switch (config / 5 % 3) {
+        case 0:
+            Run<MatchingPolicy::Fifo>(input, selfTradePrevention);
+            break;
+        case 1:
+            Run<MatchingPolicy::ProRata>(input, selfTradePrevention);
+            break;
+        default:
+            Run<MatchingPolicy::FifoProRata>(input, selfTradePrevention);
+            break;
+    }
+    return 0;
+}
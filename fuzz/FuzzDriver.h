@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../OrderBook.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+// Shared by the fuzz targets: input decoding, checks, order field generators and,
+// without libFuzzer, a main that drives LLVMFuzzerTestOneInput. Each target
+// includes it from exactly one translation unit.
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size);
+
+// Reads fixed-size values from the input, yielding zeros once it runs out
+class FuzzInput {
+public:
+    FuzzInput(const std::uint8_t* data, std::size_t size) : data_{data}, size_{size} {}
+
+    bool Empty() const { return size_ == 0; }
+
+    std::uint8_t Byte() {
+        if (size_ == 0)
+            return 0;
+        --size_;
+        return *data_++;
+    }
+
+    std::uint32_t Word() {
+        std::uint32_t word = 0;
+        for (int i = 0; i < 4; ++i)
+            word = word << 8 | Byte();
+        return word;
+    }
+
+private:
+    const std::uint8_t* data_;
+    std::size_t size_;
+};
+
+inline void Check(bool condition, const char* what) {
+    if (!condition) {
+        std::cerr << "check failed: " << what << '\n';
+        std::abort();
+    }
+}
+
+constexpr std::int32_t BasePrice = 1'000;
+
+// One of the 16 ticks around the base price
+inline std::int32_t NearPrice(FuzzInput& input) { return BasePrice + static_cast<std::int32_t>(input.Byte() % 16) - 8; }
+
+// Mostly one of the 16 ticks around the base price; sometimes far enough to land
+// outside the side's tick window
+inline std::int32_t Price(FuzzInput& input) {
+    std::uint8_t byte = input.Byte();
+    if (byte & 0x80)
+        return BasePrice + (static_cast<std::int32_t>(byte & 0x7F) - 64) * 1'500;
+    return BasePrice + static_cast<std::int32_t>(byte % 16) - 8;
+}
+
+inline Side TakeSide(FuzzInput& input) { return input.Byte() & 1 ? Side::Buy : Side::Sell; }
+
+#ifndef ORDERBOOK_LIBFUZZER
+// Replays the files given, or runs random inputs from a fixed seed
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            std::ifstream file{ argv[i], std::ios::binary };
+            std::vector<std::uint8_t> data{ std::istreambuf_iterator<char>{ file }, {} };
+            LLVMFuzzerTestOneInput(data.data(), data.size());
+        }
+        return EXIT_SUCCESS;
+    }
+
+    constexpr int Iterations = 10'000;
+    std::mt19937 random{ 1 };
+    std::vector<std::uint8_t> data;
+    for (int i = 0; i < Iterations; ++i) {
+        data.resize(random() % 4'096);
+        for (auto& byte : data)
+            byte = static_cast<std::uint8_t>(random());
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+    std::cout << Iterations << " random inputs passed\n";
+    return EXIT_SUCCESS;
+}
+#endif
@@ -0,0 +1,119 @@
+// Fuzz target for the binary protocol decoder: builds a stream of mostly valid
+// messages with fuzzed fields, occasionally corrupting the header, and feeds it to
+// a ProtocolSession in fuzzed chunk sizes as a socket would deliver it. Checks
+// that framing never over- or under-consumes, that encoders round-trip, and the
+// book's invariants. Built and driven like CrossingFuzzer.
+#include "../BinaryProtocol.h"
+#include "FuzzDriver.h"
+
+namespace {
+
+// Append one message, encoded from fuzzed fields; returns false once input is used up
+bool AppendMessage(FuzzInput& input, std::vector<std::byte>& stream) {
+    std::array<std::byte, 64> message{};
+    std::uint8_t control = input.Byte();
+    std::size_t length = 0;
+    switch (control % 5) {
+        case 0: {
+            auto type = static_cast<OrderType>(input.Byte() % 4);
+            std::uint64_t orderId = input.Byte() % 32 + 1;
+            Side side = TakeSide(input);
+            std::int32_t price = NearPrice(input);
+            std::uint32_t quantity = input.Byte() % 64;
+            std::uint32_t ownerId = input.Byte() % 4;
+            Timestamp expiry = input.Byte() & 1 ? NoExpiry : input.Byte();
+            length = MessageEncoder::EncodeNewOrder(message, type, orderId, side, price, quantity, ownerId, expiry);
+
+            NewOrderView view{ message.data() + MessageHeaderView::Length };
+            Check(view.GetOrderId() == orderId && view.GetPrice() == price && view.GetQuantity() == quantity &&
+                  view.GetOwnerId() == ownerId && view.GetExpiry() == expiry &&
+                  view.GetOrderType() == static_cast<std::uint8_t>(type) &&
+                  view.GetSide() == (side == Side::Buy ? 0 : 1), "new order does not round-trip");
+            break;
+        }
+        case 1:
+            length = MessageEncoder::EncodeCancelOrder(message, input.Byte() % 32 + 1);
+            break;
+        case 2: {
+            std::uint64_t orderId = input.Byte() % 32 + 1;
+            Side side = TakeSide(input);
+            std::int32_t price = NearPrice(input);
+            length = MessageEncoder::EncodeModifyOrder(message, orderId, side, price, input.Byte() % 64u);
+            break;
+        }
+        case 3: {
+            auto scope = static_cast<MassCancelScope>(input.Byte() % 4);
+            Side side = TakeSide(input);
+            std::int32_t first = NearPrice(input);
+            std::int32_t second = NearPrice(input);
+            length = MessageEncoder::EncodeMassCancel(message, scope, side, first, second, input.Byte() % 4);
+            break;
+        }
+        default:
+            // Raw block bytes behind a valid header
+            length = MessageHeaderView::Length + input.Byte() % 40;
+            LittleEndian::Store(message.data(), static_cast<std::uint16_t>(length - MessageHeaderView::Length));
+            LittleEndian::Store(message.data() + 2, static_cast<std::uint16_t>(input.Byte() % 6));
+            LittleEndian::Store(message.data() + 4, ProtocolSchemaId);
+            for (std::size_t i = MessageHeaderView::Length; i < length; ++i)
+                message[i] = static_cast<std::byte>(input.Byte());
+            break;
+    }
+    Check(length >= MessageHeaderView::Length, "encoder refused a large enough buffer");
+
+    // Sometimes corrupt one header or block byte
+    if (control & 0x80)
+        message[input.Byte() % length] = static_cast<std::byte>(input.Byte());
+    stream.insert(stream.end(), message.begin(), message.begin() + static_cast<std::ptrdiff_t>(length));
+    return !input.Empty();
+}
+
+void CheckBook(const OrderBook<>& book) {
+    auto infos = book.GetOrderInfos();
+    for (const auto& level : infos.GetBids())
+        Check(level.quantity > 0, "empty bid level left in the book");
+    for (const auto& level : infos.GetAsks())
+        Check(level.quantity > 0, "empty ask level left in the book");
+    if (!infos.GetBids().empty() && !infos.GetAsks().empty())
+        Check(infos.GetBids().front().price < infos.GetAsks().front().price, "book crossed");
+    Check(book.GetStats().verificationFailures == 0, "internal check failed");
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+    FuzzInput input{ data, size };
+    std::vector<std::byte> stream;
+    while (AppendMessage(input, stream)) {
+    }
+
+    // Deliver the stream in chunks of fuzzed size, keeping any partial message
+    OrderBook<> book;
+    ProtocolSession session{ book };
+    std::mt19937 chunks{ static_cast<std::uint32_t>(stream.size()) };
+    std::vector<std::byte> pending;
+    std::size_t delivered = 0, consumed = 0;
+    while (delivered < stream.size()) {
+        std::size_t chunk = std::min<std::size_t>(chunks() % 48 + 1, stream.size() - delivered);
+        pending.insert(pending.end(), stream.begin() + static_cast<std::ptrdiff_t>(delivered),
+                       stream.begin() + static_cast<std::ptrdiff_t>(delivered + chunk));
+        delivered += chunk;
+
+        std::size_t offset = 0;
+        for (;;) {
+            auto result = session.Dispatch(std::span{ pending }.subspan(offset));
+            if (result.status == DecodeStatus::Incomplete) {
+                Check(result.length == 0, "incomplete message consumed bytes");
+                break;
+            }
+            Check(result.length >= MessageHeaderView::Length && result.length <= pending.size() - offset,
+                  "message length out of bounds");
+            offset += result.length;
+            CheckBook(book);
+        }
+        pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(offset));
+        consumed += offset;
+    }
+    Check(consumed + pending.size() == stream.size(), "stream bytes lost");
+    return 0;
+}
@@ -0,0 +1,23 @@
+// Load generator for the order entry server. Reports throughput and fails if a
+// status report is missing, out of order or not decoded, or a fill names an order
+// the session did not send or is not at the resting order's price.
+//
+// Usage: LoadGenerator [port] [sessions] [messages per session] [address]
+#include "LoadGenerator.h"
+
+#include <cstdlib>
+
+int main(int argc, char** argv) {
+    auto port = static_cast<std::uint16_t>(argc > 1 ? std::atoi(argv[1]) : 9'000);
+    std::uint64_t sessions = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 8;
+    std::uint64_t messages = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 250'000;
+    std::string address = argc > 4 ? argv[4] : "127.0.0.1";
+
+    auto result = LoadGenerator{ sessions, messages }.Run(address, port);
+    if (!result)
+        return EXIT_FAILURE;
+    std::cout << sessions << " sessions, " << result->messages << " messages, " << result->fills << " fills, "
+              << result->rejected << " rejected, " << result->messages / result->seconds / 1e6
+              << " million messages/s\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+#include "../BinaryProtocol.h"
+
+#include <cerrno>
+#include <chrono>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Client side of the order entry server load test: opens several sessions over
+// TCP and streams adds, cancels, modifies and crossing orders on each, keeping a
+// bounded number of messages in flight. Fails if a status report is missing, out
+// of order or not decoded, or a fill names an order the session did not send or
+// is not at the resting order's price.
+class LoadGenerator {
+public:
+    static constexpr std::uint64_t Window = 4'096;     // Messages sent but not yet acknowledged
+    static constexpr std::uint64_t Batch = 512;        // Messages encoded per send
+
+    struct Result {
+        std::uint64_t messages;
+        std::uint64_t fills;
+        std::uint64_t rejected;
+        double seconds;
+    };
+
+    LoadGenerator(std::uint64_t sessions, std::uint64_t messages) : sessions_{sessions}, messages_{messages} {}
+
+    // Nullopt on a connection or protocol failure, described on stderr
+    std::optional<Result> Run(const std::string& address, std::uint16_t port) {
+        std::vector<Client> clients(sessions_);
+        for (std::uint64_t i = 0; i < sessions_; ++i) {
+            clients[i].id = i;
+            clients[i].fd = Connect(address, port);
+            clients[i].expected.resize(messages_);
+            if (clients[i].fd < 0) {
+                std::perror("connect");
+                Disconnect(clients);
+                return std::nullopt;
+            }
+        }
+
+        std::vector<pollfd> descriptors(sessions_);
+        auto start = std::chrono::steady_clock::now();
+        for (;;) {
+            bool done = true, progress = false;
+            for (auto& client : clients) {
+                Fill(client);
+                progress |= Send(client);
+                progress |= Receive(client);
+                if (client.failed) {
+                    Disconnect(clients);
+                    return std::nullopt;
+                }
+                done &= client.statuses == messages_;
+            }
+            if (done)
+                break;
+            if (progress)
+                continue;
+
+            for (std::uint64_t i = 0; i < sessions_; ++i) {
+                bool sending = clients[i].outputOffset < clients[i].output.size();
+                descriptors[i] = pollfd{ clients[i].fd, static_cast<short>(POLLIN | (sending ? POLLOUT : 0)), 0 };
+            }
+            if (poll(descriptors.data(), descriptors.size(), 5'000) == 0) {
+                std::cerr << "timed out waiting for the server\n";
+                Disconnect(clients);
+                return std::nullopt;
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        Result result{ sessions_ * messages_, 0, 0, elapsed.count() };
+        for (auto& client : clients) {
+            result.fills += client.fills;
+            result.rejected += client.rejected;
+        }
+        Disconnect(clients);
+        return result;
+    }
+
+private:
+    struct Message {
+        MessageType type;
+        std::uint64_t orderId;
+    };
+
+    struct Client {
+        int fd{-1};
+        std::uint64_t id{0};
+        std::uint64_t sent{0};          // Messages encoded into the send buffer
+        std::uint64_t statuses{0};
+        std::uint64_t fills{0};
+        std::uint64_t rejected{0};
+        std::vector<Message> expected;  // Per message, what its status report must name
+        std::vector<std::byte> output;
+        std::size_t outputOffset{0};
+        std::vector<std::byte> input;
+        bool failed{false};
+    };
+
+    // Resting orders are priced within [LowestResting, HighestResting]; crossing ones
+    // reach beyond it, so a fill outside it was reported at the aggressor's limit
+    static constexpr std::int32_t LowestResting = 992;
+    static constexpr std::int32_t HighestResting = 1'009;
+
+    // Order ids are scoped to the session, so each numbers its orders from 1
+    static std::uint64_t MakeOrderId(std::uint64_t i) { return i + 1; }
+
+    // Same mix as the shared-memory gateway benchmark
+    static Message Encode(std::uint64_t session, std::uint64_t i, std::span<std::byte> out, std::size_t& length) {
+        Side side = (i + session) & 1 ? Side::Buy : Side::Sell;
+        auto offset = static_cast<std::int32_t>(i % 8);
+        if (i % 4 == 3) {
+            std::uint64_t orderId = MakeOrderId(i - 2);
+            length = MessageEncoder::EncodeCancelOrder(out, orderId);
+            return { MessageType::CancelOrder, orderId };
+        }
+        if (i % 16 == 5) {
+            std::uint64_t orderId = MakeOrderId(i - 4);
+            length = MessageEncoder::EncodeModifyOrder(out, orderId, side,
+                                                       side == Side::Buy ? 999 - offset : 1'002 + offset, 10);
+            return { MessageType::ModifyOrder, orderId };
+        }
+        std::uint64_t orderId = MakeOrderId(i);
+        if (i % 16 == 9)
+            length = MessageEncoder::EncodeNewOrder(out, OrderType::FillAndKill, orderId, side,
+                                                    side == Side::Buy ? 1'010 : 990, 25);
+        else
+            length = MessageEncoder::EncodeNewOrder(out, OrderType::GoodTillCancel, orderId, side,
+                                                    side == Side::Buy ? 1'000 - offset : 1'001 + offset, 10);
+        return { MessageType::NewOrder, orderId };
+    }
+
+    static int Connect(const std::string& address, std::uint16_t port) {
+        sockaddr_in remote{};
+        remote.sin_family = AF_INET;
+        remote.sin_port = htons(port);
+        if (inet_pton(AF_INET, address.c_str(), &remote.sin_addr) != 1) {
+            errno = EINVAL;
+            return -1;
+        }
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        int noDelay = 1;
+        if (connect(fd, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) != 0 ||
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay)) != 0 ||
+            fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    static void Disconnect(std::vector<Client>& clients) {
+        for (auto& client : clients)
+            if (client.fd >= 0)
+                close(client.fd);
+    }
+
+    // Encode the next batch once the previous one is out, staying within the window
+    void Fill(Client& client) {
+        if (client.outputOffset < client.output.size())
+            return;
+        client.output.clear();
+        client.outputOffset = 0;
+        std::array<std::byte, 64> message;
+        while (client.sent < messages_ && client.sent - client.statuses < Window &&
+               client.output.size() < Batch * message.size()) {
+            std::size_t length = 0;
+            client.expected[client.sent] = Encode(client.id, client.sent, message, length);
+            client.output.insert(client.output.end(), message.begin(),
+                                 message.begin() + static_cast<std::ptrdiff_t>(length));
+            ++client.sent;
+        }
+    }
+
+    // Returns whether any bytes moved
+    static bool Send(Client& client) {
+        bool progress = false;
+        while (client.outputOffset < client.output.size()) {
+            ssize_t written = send(client.fd, client.output.data() + client.outputOffset,
+                                   client.output.size() - client.outputOffset, MSG_NOSIGNAL);
+            if (written <= 0) {
+                client.failed = written < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+                break;
+            }
+            client.outputOffset += static_cast<std::size_t>(written);
+            progress = true;
+        }
+        return progress;
+    }
+
+    static void Check(Client& client, StatusReportView report) {
+        if (client.statuses >= client.expected.size()) {
+            std::cerr << "session " << client.id << ": unexpected status report\n";
+            client.failed = true;
+            return;
+        }
+        const Message& expected = client.expected[client.statuses++];
+        if (report.GetOrderId() != expected.orderId ||
+            report.GetTemplateId() != static_cast<std::uint16_t>(expected.type) ||
+            report.GetDecodeStatus() != static_cast<std::uint8_t>(DecodeStatus::Decoded)) {
+            std::cerr << "session " << client.id << ": status report " << client.statuses - 1 << " is for order "
+                      << report.GetOrderId() << '\n';
+            client.failed = true;
+        }
+        client.rejected += report.GetOrderStatus() != static_cast<std::uint8_t>(OrderStatus::Accepted);
+    }
+
+    // A fill must name one of the session's own orders, at a resting order's price
+    static void CheckFill(Client& client, FillReportView fill) {
+        if (fill.GetOrderId() == 0 || fill.GetOrderId() > client.sent) {
+            std::cerr << "session " << client.id << ": fill for order " << fill.GetOrderId() << '\n';
+            client.failed = true;
+        }
+        if (fill.GetPrice() < LowestResting || fill.GetPrice() > HighestResting) {
+            std::cerr << "session " << client.id << ": order " << fill.GetOrderId() << " filled at "
+                      << fill.GetPrice() << ", not a resting price\n";
+            client.failed = true;
+        }
+        ++client.fills;
+    }
+
+    static bool Receive(Client& client) {
+        std::array<std::byte, 1 << 16> buffer;
+        bool progress = false;
+        for (;;) {
+            ssize_t received = recv(client.fd, buffer.data(), buffer.size(), 0);
+            if (received <= 0) {
+                if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    std::cerr << "session " << client.id << ": connection lost\n";
+                    client.failed = true;
+                }
+                break;
+            }
+            progress = true;
+            client.input.insert(client.input.end(), buffer.begin(), buffer.begin() + received);
+        }
+
+        std::size_t offset = 0;
+        while (client.input.size() - offset >= MessageHeaderView::Length) {
+            MessageHeaderView header{ client.input.data() + offset };
+            std::size_t length = MessageHeaderView::Length + header.GetBlockLength();
+            if (client.input.size() - offset < length)
+                break;
+            const std::byte* block = client.input.data() + offset + MessageHeaderView::Length;
+            if (header.GetTemplateId() == static_cast<std::uint16_t>(MessageType::StatusReport))
+                Check(client, StatusReportView{ block });
+            else
+                CheckFill(client, FillReportView{ block });
+            offset += length;
+        }
+        client.input.erase(client.input.begin(), client.input.begin() + static_cast<std::ptrdiff_t>(offset));
+        return progress;
+    }
+
+    std::uint64_t sessions_;
+    std::uint64_t messages_;
+};